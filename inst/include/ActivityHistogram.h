@@ -0,0 +1,323 @@
+// ActivityHistogram.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _ACTIVITY_HISTOGRAM_H // include guard
+#define _ACTIVITY_HISTOGRAM_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "DensityEstimation.h"
+#include "QuantileEstimation.h"
+#include "QuantileSketch.h"
+
+
+namespace bio {
+
+/**
+ * Serialization of unsigned integers in 7-bit groups, least significant first, so that small
+ * values take a single byte.
+ */
+inline void write_varint(std::ostream& out, uint64_t x) {
+  while (x >= 0x80) {
+    out.put((char) ((x & 0x7F) | 0x80));
+    x >>= 7;
+  }
+  out.put((char) x);
+}
+
+inline uint64_t read_varint(std::istream& in) {
+  uint64_t x = 0;
+  for (int shift=0; shift < 64; shift += 7) {
+    int c = in.get();
+    if (c == std::istream::traits_type::eof())
+      throw std::invalid_argument("Unexpected end of a serialized histogram");
+    x |= (uint64_t) (c & 0x7F) << shift;
+    if (!(c & 0x80))
+      return x;
+  }
+  throw std::invalid_argument("Corrupted serialized histogram");
+}
+
+
+/**
+ * Histogram of the readings of a subject on fixed bins, with the exact count, moments and
+ * extremes of the readings. It takes the same memory however many readings it receives, which
+ * suits high-frequency signals such as accelerometer activity counts, where a week of samples
+ * at tens of Hz per subject cannot be held in memory. Within a bin the readings are taken as
+ * uniformly spread, so quantiles are accurate to the bin width.
+ */
+class activity_histogram {
+public:
+  explicit activity_histogram(const arma::uword bins = 0)
+    : counts_(bins, 0), n_(0), mean_(0), m2_(0),
+      min_(std::numeric_limits<double>::infinity()), max_(-std::numeric_limits<double>::infinity()) {}
+
+  uint64_t count() const { return n_; }
+  double mean() const { return mean_; }
+  double min() const { return min_; }
+  double max() const { return max_; }
+  const std::vector<uint64_t>& counts() const { return counts_; }
+
+  double sd() const {
+    return n_ > 1 ? std::sqrt(m2_ / (n_ - 1)) : 0;
+  }
+
+  void update(const double x, const double lo, const double width) {
+    arma::uword bins = counts_.size();
+    double b = std::floor((x - lo) / width + 0.5);
+    counts_[b < 0 ? 0 : (b >= bins ? bins - 1 : (arma::uword) b)]++;
+    n_++;
+    double delta = x - mean_;
+    mean_ += delta / n_;
+    m2_ += delta * (x - mean_);
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+  }
+
+  /**
+   * Quantiles at the increasing probabilities p, written to out with the given stride. The
+   * bins are walked once for the whole grid.
+   */
+  void quantiles(const arma::vec& p, const double lo, const double width, double* out,
+                 const arma::uword stride) const {
+    arma::uword bins = counts_.size();
+    double cum = 0;
+    arma::uword b = 0;
+    for (arma::uword k=0; k < p.n_elem; k++) {
+      if (n_ == 0) {
+        out[k * stride] = std::numeric_limits<double>::quiet_NaN();
+        continue;
+      }
+      double target = p(k) * n_;
+      while (b + 1 < bins && cum + counts_[b] < target)
+        cum += counts_[b++];
+      double frac = counts_[b] > 0 ? std::min(1.0, (target - cum) / counts_[b]) : 0;
+      double x = lo + (b - 0.5 + frac) * width;
+      out[k * stride] = std::min(max_, std::max(min_, x));
+    }
+  }
+
+  void write(std::ostream& out) const {
+    write_value<uint64_t>(out, n_);
+    write_value<double>(out, mean_);
+    write_value<double>(out, m2_);
+    write_value<double>(out, min_);
+    write_value<double>(out, max_);
+    // only the non-empty bins, as the gap from the previous one and the count
+    uint64_t filled = 0;
+    for (size_t b=0; b < counts_.size(); b++)
+      filled += counts_[b] > 0;
+    write_varint(out, filled);
+    size_t previous = 0;
+    for (size_t b=0; b < counts_.size(); b++) {
+      if (counts_[b] > 0) {
+        write_varint(out, b - previous);
+        write_varint(out, counts_[b]);
+        previous = b;
+      }
+    }
+  }
+
+  /**
+   * Restores a histogram written by write, with the same number of bins.
+   */
+  void read(std::istream& in) {
+    n_ = read_value<uint64_t>(in);
+    mean_ = read_value<double>(in);
+    m2_ = read_value<double>(in);
+    min_ = read_value<double>(in);
+    max_ = read_value<double>(in);
+    std::fill(counts_.begin(), counts_.end(), 0);
+    uint64_t filled = read_varint(in);
+    uint64_t b = 0;
+    for (uint64_t i=0; i < filled; i++) {
+      b += read_varint(in);
+      if (b >= counts_.size())
+        throw std::invalid_argument("Corrupted serialized histogram");
+      counts_[b] = read_varint(in);
+    }
+  }
+
+private:
+  std::vector<uint64_t> counts_;
+  uint64_t n_;
+  double mean_;
+  double m2_;
+  double min_;
+  double max_;
+};
+
+
+/**
+ * A histogram per subject on bins of the given width centered at lo + k * width, up to hi,
+ * keyed by the subject identifier. With integer readings, such as activity counts, and unit
+ * width every value has its own bin. Readings outside [lo, hi] fall in the first or last bin.
+ * Subjects keep the order in which they were first seen. The set can be fed by stream_csv like
+ * a sketch_set.
+ */
+class histogram_set {
+public:
+  histogram_set(const double lo, const double hi, const double width) : lo_(lo), width_(width) {
+    if (!(hi > lo) || !(width > 0) || std::isinf(hi - lo))
+      throw std::invalid_argument("The histogram range must be finite and its width positive");
+    double bins = std::floor((hi - lo) / width + 1e-9) + 1;
+    if (bins > 1e8)
+      throw std::invalid_argument("The histogram has too many bins");
+    bins_ = (arma::uword) bins;
+  }
+
+  double lo() const { return lo_; }
+  double width() const { return width_; }
+  arma::uword bins() const { return bins_; }
+  arma::uword size() const { return ids_.size(); }
+  const std::vector<std::string>& ids() const { return ids_; }
+  const activity_histogram& histogram(const arma::uword i) const { return histograms_[i]; }
+
+  arma::uword index(const std::string& id) {
+    std::unordered_map<std::string, arma::uword>::iterator it = index_.find(id);
+    if (it != index_.end())
+      return it->second;
+    arma::uword i = ids_.size();
+    index_.emplace(id, i);
+    ids_.push_back(id);
+    histograms_.push_back(activity_histogram(bins_));
+    return i;
+  }
+
+  /**
+   * Appends readings. The subjects of the readings are given as 0-based indices into ids.
+   */
+  void update(const std::vector<std::string>& ids, const arma::uvec& id, const arma::vec& value) {
+    arma::uvec target(ids.size());
+    for (size_t i=0; i < ids.size(); i++)
+      target(i) = index(ids[i]);
+    group_struct buckets = group_by(id, value, ids.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int g=0; g < (int) ids.size(); g++) {
+      activity_histogram& h = histograms_[target(g)];
+      for (arma::uword i=buckets.offsets(g); i < buckets.offsets(g + 1); i++)
+        h.update(buckets.values(i), lo_, width_);
+    }
+  }
+
+  /**
+   * Quantile functions of all subjects on the grid t (one row per subject).
+   */
+  arma::mat quantiles(const arma::vec& t) const {
+    arma::uword n = histograms_.size();
+    arma::mat result(n, t.n_elem);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i=0; i < (int) n; i++)
+      histograms_[i].quantiles(t, lo_, width_, result.memptr() + i, n);
+    return result;
+  }
+
+  /**
+   * Gaussian kernel density estimates of all subjects on a common equispaced grid t (see
+   * sketch_density_matrix), from the bin centers weighted by their counts.
+   */
+  arma::mat densities(const arma::vec& t) const {
+    arma::uword m = t.n_elem;
+    if (m < 2)
+      throw std::invalid_argument("The grid t must have at least two points");
+
+    arma::uword n = histograms_.size();
+    double delta = (t(m - 1) - t(0)) / (m - 1);
+    fft_plan plan(next_pow2(2 * m));
+    arma::vec p(2);
+    p(0) = 0.25;
+    p(1) = 0.75;
+    std::vector<double> centers(bins_);
+    for (arma::uword b=0; b < bins_; b++)
+      centers[b] = lo_ + b * width_;
+    arma::mat result(n, m);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i=0; i < (int) n; i++) {
+      const activity_histogram& h = histograms_[i];
+      std::vector<double> w(h.counts().begin(), h.counts().end());
+      std::vector<double> bins(m, 0.0);
+      linear_binning(centers.data(), w.data(), bins_, t(0), delta, m, bins.data());
+      double q[2];
+      h.quantiles(p, lo_, width_, q, 1);
+      double bw = h.count() > 0 ? bandwidth_nrd0(h.sd(), q[1] - q[0], h.mean(), h.count()) : 1;
+      binned_density(plan, bins.data(), m, delta, bw, result.memptr() + i, n);
+    }
+    return result;
+  }
+
+  /**
+   * Writes the range, the bins and the histogram of every subject; read restores an identical
+   * set.
+   */
+  void write(std::ostream& out) const {
+    write_value<double>(out, lo_);
+    write_value<double>(out, width_);
+    write_value<uint64_t>(out, bins_);
+    write_value<uint64_t>(out, ids_.size());
+    for (size_t i=0; i < ids_.size(); i++) {
+      write_string(out, ids_[i]);
+      histograms_[i].write(out);
+    }
+  }
+
+  void read(std::istream& in) {
+    lo_ = read_value<double>(in);
+    width_ = read_value<double>(in);
+    bins_ = read_value<uint64_t>(in);
+    uint64_t n = read_value<uint64_t>(in);
+    if (!in || !(width_ > 0) || bins_ == 0 || bins_ > 1e8)
+      throw std::invalid_argument("Corrupted serialized histogram set");
+    ids_.clear();
+    index_.clear();
+    histograms_.clear();
+    for (uint64_t i=0; i < n; i++) {
+      arma::uword g = index(read_string(in));
+      if (g != i)
+        throw std::invalid_argument("Corrupted serialized histogram set: repeated subject");
+      histograms_[g].read(in);
+    }
+  }
+
+private:
+  double lo_;
+  double width_;
+  arma::uword bins_;
+  std::vector<std::string> ids_;
+  std::unordered_map<std::string, arma::uword> index_;
+  std::vector<activity_histogram> histograms_;
+};
+
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <stdlib.h>
 #include <string>
+#include <vector>
 #include <RcppArmadillo.h>
 #include "stdafx.h"
 #include "optimization.h"
@@ -183,6 +184,74 @@ namespace bio {
     return real_1d_array2vec(x);
   }
 
+  /**
+   * Quadratic program min x'Ax/2 + b'x s.t. al <= Cx <= au, lb <= x <= ub, prepared to be solved
+   * many times with the same A, C and box bounds. The alglib arrays and a configured solver
+   * state are built once; each solve copies the state and only sets the linear term and the
+   * bounds of the linear constraints, so no matrix is converted again. Infinite bounds are
+   * allowed. Solves are independent, so they can run in parallel.
+   */
+  class qp_projection {
+  public:
+    qp_projection(const arma::mat& A, const arma::mat& C, const arma::vec& lb, const arma::vec& ub) :
+        n(A.n_cols), k(C.n_rows) {
+      if (A.n_rows != n || C.n_cols != n || lb.n_elem != n || ub.n_elem != n)
+        throw std::invalid_argument("Non-conformant quadratic program");
+
+      // alglib arrays are row-major
+      std::vector<double> buffer(n * n);
+      for (arma::uword i=0; i < n; i++)
+        for (arma::uword j=0; j < n; j++)
+          buffer[i * n + j] = A(i, j);
+      alglib::real_2d_array as;
+      as.setcontent(n, n, buffer.data());
+
+      buffer.resize(k * n);
+      for (arma::uword i=0; i < k; i++)
+        for (arma::uword j=0; j < n; j++)
+          buffer[i * n + j] = C(i, j);
+      constraints.setcontent(k, n, buffer.data());
+
+      alglib::real_1d_array lbs, ubs;
+      lbs.setcontent(n, lb.memptr());
+      ubs.setcontent(n, ub.memptr());
+      std::vector<double> scale(n, 10);
+      alglib::real_1d_array s;
+      s.setcontent(n, scale.data());
+
+      alglib::minqpcreate(n, state);
+      alglib::minqpsetquadraticterm(state, as);
+      alglib::minqpsetbc(state, lbs, ubs);
+      alglib::minqpsetscale(state, s);
+      alglib::minqpsetalgodenseipm(state, 1.0e-5);
+    }
+
+    /**
+     * Solves the program with linear term b and bounds al <= Cx <= au.
+     */
+    arma::vec solve(const arma::vec& b, const arma::vec& al, const arma::vec& au) const {
+      if (b.n_elem != n || al.n_elem != k || au.n_elem != k)
+        throw std::invalid_argument("Non-conformant quadratic program");
+      alglib::minqpstate current(state);
+      alglib::minqpreport rep;
+      alglib::real_1d_array bs, als, aus, x;
+      bs.setcontent(n, b.memptr());
+      als.setcontent(k, al.memptr());
+      aus.setcontent(k, au.memptr());
+      alglib::minqpsetlinearterm(current, bs);
+      alglib::minqpsetlc2dense(current, constraints, als, aus, k);
+      alglib::minqpoptimize(current);
+      alglib::minqpresults(current, x, rep);
+      return arma::vec(x.getcontent(), n);
+    }
+
+  private:
+    arma::uword n;
+    arma::uword k;
+    alglib::real_2d_array constraints;
+    alglib::minqpstate state;
+  };
+
   arma::mat linear_solver(arma::mat A, arma::mat B) {
     alglib::real_2d_array As = mat2string(A).c_str();
     alglib::real_2d_array Bs = mat2string(B).c_str();
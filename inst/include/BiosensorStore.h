@@ -0,0 +1,283 @@
+// BiosensorStore.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _BIOSENSOR_STORE_H // include guard
+#define _BIOSENSOR_STORE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "CsvReader.h"
+
+
+namespace bio {
+
+/**
+ * Binary columnar store of a biosensor object. The file starts with a fixed header followed by
+ * a directory of named sections:
+ *
+ *   header    - magic "BIOSTORE", format version, byte order mark, number of sections
+ *   directory - one entry per section: name, type, rows, cols, offset and size in bytes
+ *   sections  - column-major data, each one aligned to 64 bytes
+ *
+ * Numeric sections hold rows x cols arrays (flagged STORE_MATRIX when they are matrices rather
+ * than vectors); STORE_STRING sections hold rows+1 uint64 offsets followed by the concatenated
+ * characters. The sections written by the package are quantiles, quantiles.argvals,
+ * densities, densities.argvals, ids and one variables/<name> section per covariate column.
+ */
+enum store_type {STORE_DOUBLE = 0, STORE_INT32 = 1, STORE_LOGICAL = 2, STORE_STRING = 3};
+
+const uint32_t STORE_MATRIX = 1;
+const uint32_t STORE_VERSION = 1;
+const uint32_t STORE_BOM = 0x01020304;
+const uint64_t STORE_ALIGN = 64;
+
+struct store_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t bom;
+  uint64_t sections;
+  uint64_t reserved[5];
+};
+
+struct store_entry {
+  char name[64];
+  uint32_t type;
+  uint32_t flags;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+/**
+ * A section to be written. Numeric sections point to caller-owned column-major data.
+ */
+struct store_section {
+  std::string name;
+  store_type type;
+  uint32_t flags;
+  uint64_t rows;
+  uint64_t cols;
+  const void* data;
+  std::vector<std::string> strings;
+};
+
+inline store_section store_matrix(const std::string& name, const arma::mat& A) {
+  store_section s = {name, STORE_DOUBLE, STORE_MATRIX, A.n_rows, A.n_cols, A.memptr(), std::vector<std::string>()};
+  return s;
+}
+
+inline store_section store_vector(const std::string& name, const double* x, const arma::uword n) {
+  store_section s = {name, STORE_DOUBLE, 0, n, 1, x, std::vector<std::string>()};
+  return s;
+}
+
+inline store_section store_strings(const std::string& name, const std::vector<std::string>& x) {
+  store_section s = {name, STORE_STRING, 0, x.size(), 1, NULL, x};
+  return s;
+}
+
+inline uint64_t store_padding(const uint64_t offset) {
+  return (STORE_ALIGN - offset % STORE_ALIGN) % STORE_ALIGN;
+}
+
+inline uint64_t store_bytes(const store_section& s) {
+  switch (s.type) {
+  case STORE_DOUBLE:
+    return s.rows * s.cols * sizeof(double);
+  case STORE_INT32:
+  case STORE_LOGICAL:
+    return s.rows * s.cols * sizeof(int32_t);
+  default:
+    uint64_t bytes = (s.rows + 1) * sizeof(uint64_t);
+    for (size_t i=0; i < s.strings.size(); i++)
+      bytes += s.strings[i].size();
+    return bytes;
+  }
+}
+
+
+/**
+ * This function writes a set of sections to a store file. The file is written next to its
+ * destination and renamed at the end, so readers never see a partial store. On POSIX the
+ * rename atomically replaces the previous store; on Windows the previous store is removed
+ * first, so a crash in between leaves no store.
+ * Inputs:
+ *   filename - path of the store
+ *   sections - the sections to write
+ */
+inline void write_store(const std::string& filename, const std::vector<store_section>& sections) {
+  store_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "BIOSTORE", 8);
+  header.version = STORE_VERSION;
+  header.bom = STORE_BOM;
+  header.sections = sections.size();
+
+  std::vector<store_entry> directory(sections.size());
+  uint64_t offset = sizeof(store_header) + sections.size() * sizeof(store_entry);
+  for (size_t i=0; i < sections.size(); i++) {
+    const store_section& s = sections[i];
+    if (s.name.size() >= sizeof(directory[i].name))
+      throw std::invalid_argument("Section name too long: " + s.name);
+    memset(&directory[i], 0, sizeof(store_entry));
+    memcpy(directory[i].name, s.name.c_str(), s.name.size());
+    offset += store_padding(offset);
+    directory[i].type = s.type;
+    directory[i].flags = s.flags;
+    directory[i].rows = s.rows;
+    directory[i].cols = s.cols;
+    directory[i].offset = offset;
+    directory[i].bytes = store_bytes(s);
+    offset += directory[i].bytes;
+  }
+
+  std::string tmp = filename + ".tmp";
+  {
+    std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+      throw std::invalid_argument("Unable to create file " + tmp);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(store_entry));
+    uint64_t position = sizeof(store_header) + sections.size() * sizeof(store_entry);
+    const char zeros[STORE_ALIGN] = {0};
+    for (size_t i=0; i < sections.size(); i++) {
+      const store_section& s = sections[i];
+      out.write(zeros, directory[i].offset - position);
+      if (s.type == STORE_STRING) {
+        uint64_t o = 0;
+        for (size_t k=0; k < s.strings.size(); k++) {
+          out.write(reinterpret_cast<const char*>(&o), sizeof(o));
+          o += s.strings[k].size();
+        }
+        out.write(reinterpret_cast<const char*>(&o), sizeof(o));
+        for (size_t k=0; k < s.strings.size(); k++)
+          out.write(s.strings[k].data(), s.strings[k].size());
+      } else {
+        out.write(static_cast<const char*>(s.data), directory[i].bytes);
+      }
+      position = directory[i].offset + directory[i].bytes;
+    }
+    if (!out)
+      throw std::runtime_error("Error while writing file " + tmp);
+  }
+#ifdef _WIN32
+  remove(filename.c_str());
+#endif
+  if (rename(tmp.c_str(), filename.c_str()) != 0)
+    throw std::runtime_error("Unable to rename " + tmp + " to " + filename);
+}
+
+
+/**
+ * Read-only view of a store file. The file is memory-mapped and numeric sections are exposed
+ * as armadillo matrices that use the mapped memory directly, without copies.
+ */
+class biosensor_store {
+public:
+  explicit biosensor_store(const std::string& filename) : file_(filename) {
+    if (file_.size() < sizeof(store_header))
+      throw std::invalid_argument("The file " + filename + " is not a biosensor store");
+    const store_header* header = reinterpret_cast<const store_header*>(file_.begin());
+    if (memcmp(header->magic, "BIOSTORE", 8) != 0)
+      throw std::invalid_argument("The file " + filename + " is not a biosensor store");
+    if (header->bom != STORE_BOM)
+      throw std::invalid_argument("The store " + filename + " was written with a different byte order");
+    if (header->version > STORE_VERSION)
+      throw std::invalid_argument("The store " + filename + " was written by a newer version of the package");
+    if (sizeof(store_header) + header->sections * sizeof(store_entry) > file_.size())
+      throw std::invalid_argument("The store " + filename + " is truncated");
+
+    const store_entry* entries = reinterpret_cast<const store_entry*>(file_.begin() + sizeof(store_header));
+    directory_.assign(entries, entries + header->sections);
+    for (size_t i=0; i < directory_.size(); i++) {
+      directory_[i].name[sizeof(directory_[i].name) - 1] = '\0';
+      if (directory_[i].offset + directory_[i].bytes > file_.size())
+        throw std::invalid_argument("The store " + filename + " is truncated");
+    }
+  }
+
+  std::vector<std::string> names() const {
+    std::vector<std::string> result;
+    for (size_t i=0; i < directory_.size(); i++)
+      result.push_back(directory_[i].name);
+    return result;
+  }
+
+  bool has(const std::string& name) const {
+    return find(name) != NULL;
+  }
+
+  const store_entry& entry(const std::string& name) const {
+    const store_entry* e = find(name);
+    if (e == NULL)
+      throw std::invalid_argument("The store has no section " + name);
+    return *e;
+  }
+
+  const void* data(const std::string& name) const {
+    return file_.begin() + entry(name).offset;
+  }
+
+  /**
+   * A numeric section as a matrix backed by the mapped file. The matrix must not be modified.
+   */
+  const arma::mat matrix(const std::string& name) const {
+    const store_entry& e = entry(name);
+    if (e.type != STORE_DOUBLE)
+      throw std::invalid_argument("The section " + name + " is not a double matrix");
+    double* p = const_cast<double*>(reinterpret_cast<const double*>(file_.begin() + e.offset));
+    return arma::mat(p, e.rows, e.cols, false, true);
+  }
+
+  std::vector<std::string> strings(const std::string& name) const {
+    const store_entry& e = entry(name);
+    if (e.type != STORE_STRING)
+      throw std::invalid_argument("The section " + name + " is not a string column");
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file_.begin() + e.offset);
+    const char* chars = reinterpret_cast<const char*>(offsets + e.rows + 1);
+    std::vector<std::string> result(e.rows);
+    for (uint64_t i=0; i < e.rows; i++)
+      result[i].assign(chars + offsets[i], chars + offsets[i + 1]);
+    return result;
+  }
+
+private:
+  const store_entry* find(const std::string& name) const {
+    for (size_t i=0; i < directory_.size(); i++) {
+      if (name == directory_[i].name)
+        return &directory_[i];
+    }
+    return NULL;
+  }
+
+  mapped_file file_;
+  std::vector<store_entry> directory_;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,611 @@
+// CsvReader.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _CSV_READER_H // include guard
+#define _CSV_READER_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <RcppArmadillo.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace bio {
+
+struct csv_struct {
+  arma::vec time;                // seconds since 1970-01-01 00:00:00 UTC (NaN if missing)
+  arma::vec value;
+  arma::uvec id;                 // index into ids
+  std::vector<std::string> ids;  // subject identifiers in order of first appearance
+  arma::uword rows;
+  arma::uword rejected;
+  double seconds;
+  double rows_per_second;
+  std::vector<std::string> subjects;  // every subject seen, including those without valid readings
+  arma::umat counts;                  // per subject: valid, substituted and rejected readings
+};
+
+/**
+ * Cleaning applied to the values while they are parsed. Sensor sentinels (for example, "Low" or
+ * "High") are replaced by a value, or rejected if their substitute is NaN. Readings outside
+ * [min, max] are rejected.
+ */
+struct csv_options {
+  std::vector<std::string> sentinels;
+  std::vector<double> substitutes;
+  double min;
+  double max;
+
+  csv_options() : min(-std::numeric_limits<double>::infinity()), max(std::numeric_limits<double>::infinity()) {}
+};
+
+/**
+ * Column positions of the fields used by the package in a csv file.
+ */
+struct csv_layout {
+  int time;
+  int value;
+  int id;
+  std::string subject;   // id of every row of a file without an id column
+};
+
+/**
+ * Read-only view of a whole file. The file is memory-mapped where the platform allows it and
+ * read into memory otherwise.
+ */
+class mapped_file {
+public:
+  explicit mapped_file(const std::string& filename) : data_(NULL), size_(0), mapped_(false) {
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::invalid_argument("Unable to open file " + filename);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::invalid_argument("Unable to stat file " + filename);
+    }
+    size_ = (size_t) st.st_size;
+    if (size_ > 0) {
+      void* p = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+        mapped_ = true;
+      }
+    }
+    ::close(fd);
+    if (mapped_ || size_ == 0)
+      return;
+#endif
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in)
+      throw std::invalid_argument("Unable to open file " + filename);
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+
+  ~mapped_file() {
+#ifndef _WIN32
+    if (mapped_)
+      ::munmap(const_cast<char*>(data_), size_);
+#endif
+  }
+
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+
+private:
+  mapped_file(const mapped_file&);
+  mapped_file& operator=(const mapped_file&);
+
+  const char* data_;
+  size_t size_;
+  bool mapped_;
+  std::string buffer_;
+};
+
+
+/**
+ * Extracts the next comma-separated field starting at p. Surrounding double quotes are removed.
+ * Inputs:
+ *   p, end - current position and end of the line
+ * Outputs:
+ *   fb, fe - bounds of the field content
+ *   the position just after the field separator
+ */
+inline const char* csv_field(const char* p, const char* end, const char*& fb, const char*& fe) {
+  if (p < end && *p == '"') {
+    fb = ++p;
+    while (p < end && !(*p == '"' && (p + 1 == end || p[1] != '"')))
+      p += (*p == '"') ? 2 : 1;
+    fe = p;
+    while (p < end && *p != ',')
+      p++;
+  } else {
+    fb = p;
+    while (p < end && *p != ',')
+      p++;
+    fe = p;
+  }
+  return p < end ? p + 1 : end;
+}
+
+/**
+ * Returns the end of the line starting at p, skipping a trailing carriage return.
+ */
+inline const char* csv_line_end(const char* p, const char* end, const char*& next) {
+  const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+  next = nl ? nl + 1 : end;
+  const char* e = nl ? nl : end;
+  if (e > p && e[-1] == '\r')
+    e--;
+  return e;
+}
+
+/**
+ * Locates the time, value and id columns in the header line of a csv file.
+ * Inputs:
+ *   begin, end - bounds of the header line
+ *   subject    - id of the rows if the file has no id column (empty requires the column)
+ * Outputs:
+ *   the column layout (-1 for the columns not found)
+ */
+inline csv_layout csv_header(const char* begin, const char* end, const std::string& subject = "") {
+  csv_layout layout = {-1, -1, -1, subject};
+  const char* p = begin;
+  if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+    p += 3;
+  int col = 0;
+  while (p < end) {
+    const char *fb, *fe;
+    p = csv_field(p, end, fb, fe);
+    std::string name(fb, fe);
+    if (name == "time")
+      layout.time = col;
+    else if (name == "value")
+      layout.value = col;
+    else if (name == "id")
+      layout.id = col;
+    col++;
+  }
+  if (layout.value < 0)
+    throw std::invalid_argument("The csv file filename_fdata must have a column named 'value'.");
+  if (layout.id < 0 && subject.empty())
+    throw std::invalid_argument("The csv file filename_fdata must have a column named 'id'.");
+  return layout;
+}
+
+/**
+ * Parses a monitor value. As in the previous R implementation, only values starting with a
+ * digit are accepted. The whole field must be a number, so "12abc" and fields too long for the
+ * buffer are rejected.
+ */
+inline bool csv_value(const char* b, const char* e, double& value) {
+  char buffer[64];
+  size_t len = e - b;
+  if (b == e || *b < '0' || *b > '9' || len >= sizeof(buffer))
+    return false;
+  memcpy(buffer, b, len);
+  buffer[len] = '\0';
+  char* stop;
+  value = strtod(buffer, &stop);
+  return stop == buffer + len && !std::isnan(value);
+}
+
+inline bool csv_digits(const char*& p, const char* e, int n, int& out) {
+  out = 0;
+  for (int i = 0; i < n; i++, p++) {
+    if (p >= e || *p < '0' || *p > '9')
+      return false;
+    out = out * 10 + (*p - '0');
+  }
+  return true;
+}
+
+/**
+ * Parses a timestamp of the form YYYY-MM-DD[ T]HH:MM[:SS] (or a plain number of seconds) into
+ * seconds since 1970-01-01 00:00:00 UTC. Returns NaN when the field can not be parsed.
+ */
+inline double csv_time(const char* b, const char* e) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const char* p = b;
+  int y, mo, d, h = 0, mi = 0, s = 0;
+  if (!csv_digits(p, e, 4, y) || p >= e || *p != '-') {
+    double value;
+    return csv_value(b, e, value) ? value : nan;
+  }
+  p++;
+  if (!csv_digits(p, e, 2, mo) || p >= e || *p++ != '-' || !csv_digits(p, e, 2, d))
+    return nan;
+  if (p < e && (*p == ' ' || *p == 'T')) {
+    p++;
+    if (!csv_digits(p, e, 2, h) || p >= e || *p++ != ':' || !csv_digits(p, e, 2, mi))
+      return nan;
+    if (p < e && *p == ':') {
+      p++;
+      if (!csv_digits(p, e, 2, s))
+        return nan;
+    }
+  }
+  // days from civil (proleptic Gregorian calendar)
+  y -= mo <= 2;
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;
+  long doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  long days = era * 146097 + doe - 719468;
+  return days * 86400.0 + h * 3600.0 + mi * 60.0 + s;
+}
+
+
+/**
+ * Parses and cleans a monitor value.
+ * Outputs:
+ *   0 if the value is rejected, 1 if it is valid and 2 if it is a substituted sentinel.
+ */
+inline int csv_clean(const char* b, const char* e, const csv_options& options, double& value) {
+  int status = 1;
+  if (!csv_value(b, e, value)) {
+    size_t len = e - b;
+    size_t k = 0;
+    while (k < options.sentinels.size() &&
+           (options.sentinels[k].size() != len || memcmp(options.sentinels[k].data(), b, len) != 0))
+      k++;
+    if (k == options.sentinels.size() || std::isnan(options.substitutes[k]))
+      return 0;
+    value = options.substitutes[k];
+    status = 2;
+  }
+  return value >= options.min && value <= options.max ? status : 0;
+}
+
+
+/**
+ * Rows parsed from a contiguous block of a csv file. Subjects are numbered locally in order of
+ * first appearance within the block; those with valid readings are also listed in order of their
+ * first valid reading, which is the order of the subjects in the parsed data.
+ */
+struct csv_chunk {
+  std::vector<double> time;
+  std::vector<double> value;
+  std::vector<arma::uword> id;
+  std::vector<std::string> ids;
+  std::unordered_map<std::string, arma::uword> index;
+  std::vector<arma::uword> order;
+  std::vector<arma::uword> valid;
+  std::vector<arma::uword> substituted;
+  std::vector<arma::uword> rejected_by;
+  arma::uword rows;
+  arma::uword rejected;
+
+  csv_chunk() : rows(0), rejected(0) {}
+
+  arma::uword code(const char* b, const char* e) {
+    std::string key(b, e);
+    std::unordered_map<std::string, arma::uword>::iterator it = index.find(key);
+    if (it != index.end())
+      return it->second;
+    arma::uword c = ids.size();
+    index.emplace(key, c);
+    ids.push_back(key);
+    valid.push_back(0);
+    substituted.push_back(0);
+    rejected_by.push_back(0);
+    return c;
+  }
+};
+
+/**
+ * Parses and validates the data rows in [begin, end). The block must start at the beginning of
+ * a line.
+ */
+inline void csv_parse(const char* begin, const char* end, const csv_layout& layout, const csv_options& options,
+                      csv_chunk& chunk) {
+  int last = std::max(layout.time, std::max(layout.value, layout.id));
+  // readings of the same subject are usually contiguous, so remember the last id seen
+  const char* last_b = NULL;
+  size_t last_len = 0;
+  arma::uword last_code = 0;
+
+  const char* p = begin;
+  while (p < end) {
+    const char* next;
+    const char* le = csv_line_end(p, end, next);
+    if (le == p) {
+      p = next;
+      continue;
+    }
+    chunk.rows++;
+    const char *tb = NULL, *te = NULL, *vb = NULL, *ve = NULL, *ib = NULL, *ie = NULL;
+    const char* q = p;
+    for (int col = 0; col <= last; col++) {
+      const char *fb, *fe;
+      q = csv_field(q, le, fb, fe);
+      if (col == layout.time) { tb = fb; te = fe; }
+      else if (col == layout.value) { vb = fb; ve = fe; }
+      else if (col == layout.id) { ib = fb; ie = fe; }
+    }
+    if (layout.id < 0) {
+      ib = layout.subject.data();
+      ie = ib + layout.subject.size();
+    }
+    if (ib == NULL) {
+      chunk.rejected++;
+      p = next;
+      continue;
+    }
+    size_t len = ie - ib;
+    if (last_b == NULL || len != last_len || memcmp(ib, last_b, len) != 0) {
+      last_code = chunk.code(ib, ie);
+      last_b = ib;
+      last_len = len;
+    }
+    double value;
+    int status = vb != NULL ? csv_clean(vb, ve, options, value) : 0;
+    if (status == 0) {
+      chunk.rejected++;
+      chunk.rejected_by[last_code]++;
+      p = next;
+      continue;
+    }
+    if (chunk.valid[last_code]++ == 0)
+      chunk.order.push_back(last_code);
+    if (status == 2)
+      chunk.substituted[last_code]++;
+    chunk.value.push_back(value);
+    chunk.id.push_back(last_code);
+    chunk.time.push_back(tb != NULL ? csv_time(tb, te) : std::numeric_limits<double>::quiet_NaN());
+    p = next;
+  }
+}
+
+/**
+ * Merges the chunks in order into columnar buffers, renumbering the subjects globally by order
+ * of first appearance, and adds up the per-subject counts.
+ */
+inline void csv_merge(std::vector<csv_chunk>& chunks, csv_struct& result) {
+  std::unordered_map<std::string, arma::uword> index, subjects;
+  std::vector<std::vector<arma::uword> > recode(chunks.size());
+  std::vector<arma::uword> offset(chunks.size() + 1, 0);
+  std::vector<arma::uword> valid, substituted, rejected;
+  result.rows = 0;
+  result.rejected = 0;
+  result.ids.clear();
+  result.subjects.clear();
+  for (size_t c = 0; c < chunks.size(); c++) {
+    const csv_chunk& chunk = chunks[c];
+    recode[c].resize(chunk.ids.size());
+    for (size_t k = 0; k < chunk.order.size(); k++) {
+      arma::uword i = chunk.order[k];
+      std::unordered_map<std::string, arma::uword>::iterator it = index.find(chunk.ids[i]);
+      if (it == index.end()) {
+        it = index.emplace(chunk.ids[i], result.ids.size()).first;
+        result.ids.push_back(chunk.ids[i]);
+      }
+      recode[c][i] = it->second;
+    }
+    for (size_t i = 0; i < chunk.ids.size(); i++) {
+      std::unordered_map<std::string, arma::uword>::iterator it = subjects.find(chunk.ids[i]);
+      if (it == subjects.end()) {
+        it = subjects.emplace(chunk.ids[i], result.subjects.size()).first;
+        result.subjects.push_back(chunk.ids[i]);
+        valid.push_back(0);
+        substituted.push_back(0);
+        rejected.push_back(0);
+      }
+      valid[it->second] += chunk.valid[i];
+      substituted[it->second] += chunk.substituted[i];
+      rejected[it->second] += chunk.rejected_by[i];
+    }
+    offset[c + 1] = offset[c] + chunk.value.size();
+    result.rows += chunk.rows;
+    result.rejected += chunk.rejected;
+  }
+  result.counts.set_size(result.subjects.size(), 3);
+  for (arma::uword i = 0; i < result.subjects.size(); i++) {
+    result.counts(i, 0) = valid[i];
+    result.counts(i, 1) = substituted[i];
+    result.counts(i, 2) = rejected[i];
+  }
+
+  arma::uword total = offset[chunks.size()];
+  result.time.set_size(total);
+  result.value.set_size(total);
+  result.id.set_size(total);
+
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < (int) chunks.size(); c++) {
+    csv_chunk& chunk = chunks[c];
+    arma::uword o = offset[c];
+    for (size_t i = 0; i < chunk.value.size(); i++) {
+      result.time(o + i) = chunk.time[i];
+      result.value(o + i) = chunk.value[i];
+      result.id(o + i) = recode[c][chunk.id[i]];
+    }
+    std::vector<double>().swap(chunk.time);
+    std::vector<double>().swap(chunk.value);
+    std::vector<arma::uword>().swap(chunk.id);
+  }
+}
+
+
+/**
+ * Parses the data rows in [begin, end) in parallel. The range is split in blocks at line
+ * boundaries, each block is parsed by a thread and the blocks are merged in order.
+ * Inputs:
+ *   begin, end - bounds of the data rows (begin must be at the beginning of a line)
+ *   layout     - column layout of the file
+ *   options    - cleaning of the values
+ *   nthreads   - number of threads
+ * Outputs:
+ *   result     - the columnar buffers, subject identifiers and row counts
+ */
+inline void csv_parse_blocks(const char* begin, const char* end, const csv_layout& layout,
+                             const csv_options& options, const int nthreads, csv_struct& result) {
+  // a few blocks per thread keep the load balanced, but blocks should not be too small
+  size_t length = end - begin;
+  size_t nblocks = std::max((size_t) 1, std::min((size_t) nthreads * 4, length / (1 << 20)));
+  std::vector<const char*> bounds(nblocks + 1);
+  bounds[0] = begin;
+  bounds[nblocks] = end;
+  for (size_t b = 1; b < nblocks; b++) {
+    const char* p = begin + b * (length / nblocks);
+    p = std::max(p, bounds[b - 1]);
+    const char* nl = p < end ? static_cast<const char*>(memchr(p, '\n', end - p)) : NULL;
+    bounds[b] = nl ? nl + 1 : end;
+  }
+
+  std::vector<csv_chunk> chunks(nblocks);
+  #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+  for (int b = 0; b < (int) nblocks; b++) {
+    size_t bytes = bounds[b + 1] - bounds[b];
+    chunks[b].value.reserve(bytes / 16);
+    chunks[b].time.reserve(bytes / 16);
+    chunks[b].id.reserve(bytes / 16);
+    csv_parse(bounds[b], bounds[b + 1], layout, options, chunks[b]);
+  }
+
+  csv_merge(chunks, result);
+}
+
+/**
+ * Number of threads to use for a requested count (0 uses the OpenMP default).
+ */
+inline int csv_threads(const int threads) {
+  int nthreads = 1;
+#ifdef _OPENMP
+  nthreads = threads > 0 ? threads : omp_get_max_threads();
+#endif
+  return nthreads;
+}
+
+
+/**
+ * This function reads a long-format csv file with the columns time, value and id. The file is
+ * memory-mapped and split in blocks at line boundaries that are parsed and validated in parallel.
+ * Rows whose value does not start with a digit are rejected, unless the value is a sentinel with
+ * a substitute; readings out of the range of the options are rejected as well.
+ * Inputs:
+ *   filename - path of the csv file
+ *   threads  - number of threads (0 uses the OpenMP default)
+ *   options  - cleaning of the values
+ * Outputs:
+ *   A structure with the columnar buffers time, value and id, the subject identifiers, the
+ *   number of rows read and rejected, the throughput in rows per second, and the number of
+ *   valid, substituted and rejected readings of each subject.
+ */
+inline csv_struct read_csv(const std::string& filename, int threads = 0, const csv_options& options = csv_options()) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  mapped_file file(filename);
+  const char* begin = file.begin();
+  const char* end = file.end();
+  if (begin == end)
+    throw std::invalid_argument("The csv file " + filename + " is empty");
+
+  const char* body;
+  const char* header_end = csv_line_end(begin, end, body);
+  csv_layout layout = csv_header(begin, header_end);
+
+  csv_struct result;
+  csv_parse_blocks(body, end, layout, options, csv_threads(threads), result);
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.rows_per_second = result.seconds > 0 ? result.rows / result.seconds : 0;
+  return result;
+}
+
+
+
+/**
+ * This function reads a set of long-format csv files (see read_csv), for example one file per
+ * subject and upload. Files are distributed across threads, each file is parsed by a single
+ * thread, and the rows of all files are then merged in file order, so readings of a subject
+ * split across several files are gathered together.
+ * Inputs:
+ *   filenames - paths of the csv files
+ *   threads   - number of threads (0 uses the OpenMP default)
+ *   options   - cleaning of the values
+ * Outputs:
+ *   The same structure as read_csv.
+ */
+inline csv_struct read_csv_files(const std::vector<std::string>& filenames, int threads = 0,
+                                 const csv_options& options = csv_options()) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<csv_chunk> chunks(filenames.size());
+  std::vector<std::string> errors(filenames.size());
+
+  // exceptions can not leave a parallel region, so they are collected and rethrown afterwards
+  #pragma omp parallel for schedule(dynamic) num_threads(csv_threads(threads))
+  for (int f = 0; f < (int) filenames.size(); f++) {
+    try {
+      mapped_file file(filenames[f]);
+      if (file.size() == 0)
+        throw std::invalid_argument("The csv file is empty");
+      const char* body;
+      const char* header_end = csv_line_end(file.begin(), file.end(), body);
+      csv_layout layout = csv_header(file.begin(), header_end);
+      size_t bytes = file.end() - body;
+      chunks[f].value.reserve(bytes / 16);
+      chunks[f].time.reserve(bytes / 16);
+      chunks[f].id.reserve(bytes / 16);
+      csv_parse(body, file.end(), layout, options, chunks[f]);
+    } catch (std::exception& e) {
+      errors[f] = e.what();
+    }
+  }
+  for (size_t f = 0; f < filenames.size(); f++) {
+    if (!errors[f].empty() && errors[f].find(filenames[f]) == std::string::npos)
+      throw std::invalid_argument(errors[f] + " (" + filenames[f] + ")");
+    if (!errors[f].empty())
+      throw std::invalid_argument(errors[f]);
+  }
+
+  csv_struct result;
+  csv_merge(chunks, result);
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.rows_per_second = result.seconds > 0 ? result.rows / result.seconds : 0;
+  return result;
+}
+
+
+}
+
+#endif
@@ -0,0 +1,297 @@
+// DensityEstimation.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _DENSITY_ESTIMATION_H // include guard
+#define _DENSITY_ESTIMATION_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "QuantileEstimation.h"
+
+
+namespace bio {
+
+/**
+ * Precomputed twiddle factors and bit reversal permutation of a radix-2 FFT of length n.
+ * A plan is read-only once built, so it can be shared between threads.
+ */
+class fft_plan {
+public:
+  explicit fft_plan(const arma::uword n) : n_(n), twiddles_(n / 2), reversal_(n) {
+    if (n == 0 || (n & (n - 1)) != 0)
+      throw std::invalid_argument("The length of the FFT must be a power of two");
+    for (arma::uword k=0; k < n / 2; k++)
+      twiddles_[k] = std::polar(1.0, -2 * M_PI * k / n);
+    arma::uword bits = 0;
+    while (((arma::uword) 1 << bits) < n)
+      bits++;
+    for (arma::uword i=0; i < n; i++) {
+      arma::uword r = 0;
+      for (arma::uword b=0; b < bits; b++)
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      reversal_[i] = r;
+    }
+  }
+
+  arma::uword size() const { return n_; }
+
+  /**
+   * In-place transform of a (forward, or unscaled inverse if inverse is true).
+   */
+  void transform(std::vector<std::complex<double> >& a, const bool inverse) const {
+    for (arma::uword i=0; i < n_; i++) {
+      if (i < reversal_[i])
+        std::swap(a[i], a[reversal_[i]]);
+    }
+    for (arma::uword len=2; len <= n_; len <<= 1) {
+      arma::uword step = n_ / len;
+      for (arma::uword i=0; i < n_; i += len) {
+        for (arma::uword k=0; k < len / 2; k++) {
+          std::complex<double> w = inverse ? std::conj(twiddles_[k * step]) : twiddles_[k * step];
+          std::complex<double> u = a[i + k];
+          std::complex<double> v = a[i + k + len / 2] * w;
+          a[i + k] = u + v;
+          a[i + k + len / 2] = u - v;
+        }
+      }
+    }
+  }
+
+private:
+  arma::uword n_;
+  std::vector<std::complex<double> > twiddles_;
+  std::vector<arma::uword> reversal_;
+};
+
+/**
+ * Smallest power of two not lower than n.
+ */
+inline arma::uword next_pow2(const arma::uword n) {
+  arma::uword p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+/**
+ * Bandwidth of Silverman's rule of thumb, as computed by stats::bw.nrd0, from the summary
+ * statistics of a sample: standard deviation, interquartile range, first value and size.
+ */
+inline double bandwidth_nrd0(const double sd, const double iqr, const double first, const arma::uword n) {
+  double lo = std::min(sd, iqr / 1.34);
+  if (!(lo > 0)) {
+    lo = sd;
+    if (!(lo > 0))
+      lo = std::abs(first);
+    if (!(lo > 0))
+      lo = 1;
+  }
+  return 0.9 * lo * std::pow((double) n, -0.2);
+}
+
+/**
+ * Bandwidth of Silverman's rule of thumb, as computed by stats::bw.nrd0. The array x is reordered.
+ */
+inline double bandwidth_nrd0(double* x, const arma::uword n) {
+  if (n == 0)
+    return 1;
+  double mean = 0;
+  for (arma::uword i=0; i < n; i++)
+    mean += x[i];
+  mean /= n;
+  double ss = 0;
+  for (arma::uword i=0; i < n; i++)
+    ss += (x[i] - mean) * (x[i] - mean);
+  double hi = n > 1 ? std::sqrt(ss / (n - 1)) : 0;
+  double first = x[0];
+
+  arma::vec p(2);
+  p(0) = 0.25;
+  p(1) = 0.75;
+  double q[2];
+  sample_quantiles(x, n, p, q, 1);
+  return bandwidth_nrd0(hi, q[1] - q[0], first, n);
+}
+
+/**
+ * Linear binning of weighted points onto the equispaced grid t0 + j*delta, j = 0, ..., m-1.
+ * Points outside the grid are assigned to the nearest end.
+ */
+inline void linear_binning(const double* x, const double* w, const arma::uword n, const double t0,
+                           const double delta, const arma::uword m, double* bins) {
+  for (arma::uword i=0; i < n; i++) {
+    double u = delta > 0 ? (x[i] - t0) / delta : 0;
+    double weight = w ? w[i] : 1.0;
+    if (!(u > 0)) {
+      bins[0] += weight;
+    } else if (u >= m - 1) {
+      bins[m - 1] += weight;
+    } else {
+      arma::uword j = (arma::uword) u;
+      double frac = u - j;
+      bins[j] += weight * (1 - frac);
+      bins[j + 1] += weight * frac;
+    }
+  }
+}
+
+/**
+ * Gaussian kernel density estimate on an equispaced grid from binned counts, by FFT
+ * convolution of the bins with the sampled kernel.
+ * Inputs:
+ *   plan  - FFT plan of length at least 2*m
+ *   bins  - 1xm vector of binned weights (normalized to sum 1 here)
+ *   delta - grid spacing
+ *   bw    - bandwidth (standard deviation of the kernel)
+ *   out   - output array with the m density values, with stride between consecutive values
+ */
+inline void binned_density(const fft_plan& plan, const double* bins, const arma::uword m, const double delta,
+                           const double bw, double* out, const arma::uword stride) {
+  arma::uword n = plan.size();
+  double total = 0;
+  for (arma::uword j=0; j < m; j++)
+    total += bins[j];
+  if (!(total > 0) || !(bw > 0) || !(delta > 0) || n < 2 * m) {
+    for (arma::uword j=0; j < m; j++)
+      out[j * stride] = 0;
+    return;
+  }
+
+  // lags beyond m-1 never contribute, so the kernel is truncated there to avoid wrap around
+  arma::uword K = (arma::uword) std::min((double) (m - 1), std::ceil(4 * bw / delta));
+  std::vector<std::complex<double> > a(n), k(n);
+  for (arma::uword j=0; j < m; j++)
+    a[j] = bins[j] / total;
+  double scale = 1 / (bw * std::sqrt(2 * M_PI));
+  for (arma::uword j=0; j <= K; j++) {
+    double z = j * delta / bw;
+    double v = scale * std::exp(-0.5 * z * z);
+    k[j] = v;
+    if (j > 0)
+      k[n - j] = v;
+  }
+
+  plan.transform(a, false);
+  plan.transform(k, false);
+  for (arma::uword j=0; j < n; j++)
+    a[j] *= k[j];
+  plan.transform(a, true);
+
+  for (arma::uword j=0; j < m; j++)
+    out[j * stride] = std::max(0.0, a[j].real() / n);
+}
+
+
+/**
+ * This function computes a Gaussian kernel density estimate of each subject on a common
+ * equispaced grid. Readings are linearly binned onto the grid and convolved with the kernel by
+ * FFT, using for each subject the bandwidth of stats::bw.nrd0, in parallel across subjects.
+ * Inputs:
+ *   id     - 0-based subject index of each reading
+ *   value  - the readings
+ *   groups - number of subjects
+ *   t      - 1xm equispaced grid covering the range of the readings
+ * Outputs:
+ *   A groups x m matrix whose row g contains the density of subject g on the grid t.
+ */
+inline arma::mat density_matrix(const arma::uvec& id, const arma::vec& value, const arma::uword groups, const arma::vec& t) {
+  arma::uword m = t.n_elem;
+  if (m < 2)
+    throw std::invalid_argument("The grid t must have at least two points");
+
+  group_struct buckets = group_by(id, value, groups);
+  double delta = (t(m - 1) - t(0)) / (m - 1);
+  fft_plan plan(next_pow2(2 * m));
+  arma::mat result(groups, m);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++) {
+    arma::uword begin = buckets.offsets(g);
+    arma::uword n = buckets.offsets(g + 1) - begin;
+    double* x = buckets.values.memptr() + begin;
+    std::vector<double> bins(m, 0.0);
+    linear_binning(x, NULL, n, t(0), delta, m, bins.data());
+    double bw = bandwidth_nrd0(x, n);
+    binned_density(plan, bins.data(), m, delta, bw, result.memptr() + g, groups);
+  }
+  return result;
+}
+
+
+/**
+ * This function evaluates on a common grid of values the densities of a set of distributions
+ * given by their quantile functions Q and quantile densities q on a grid of probabilities. The
+ * density at Q(t) is 1 / q(t), so each row is known on its own grid Q(i, :); it is linearly
+ * interpolated onto x, and is zero outside the range of Q(i, :). Both Q(i, :) and x are sorted,
+ * so each row is mapped with a single merge walk over the two grids, in parallel over rows.
+ * Inputs:
+ *   Q - nxm matrix of quantile functions, non-decreasing along rows
+ *   q - nxm matrix of positive quantile densities
+ *   x - 1xp increasing grid of values
+ * Outputs:
+ *   A nxp matrix whose row i contains the density of distribution i on the grid x.
+ */
+inline arma::mat quantile_to_density(const arma::mat& Q, const arma::mat& q, const arma::vec& x) {
+  if (Q.n_rows != q.n_rows || Q.n_cols != q.n_cols)
+    throw std::invalid_argument("The quantile functions and quantile densities must have the same dimensions");
+  if (Q.n_cols < 2)
+    throw std::invalid_argument("The grid of probabilities must have at least two points");
+  for (arma::uword k=1; k < x.n_elem; k++) {
+    if (!(x(k) > x(k - 1)))
+      throw std::invalid_argument("The grid of values must be increasing");
+  }
+
+  // rows become contiguous columns
+  arma::mat Qt = Q.t(), qt = q.t();
+  arma::uword n = Q.n_rows, m = Q.n_cols, p = x.n_elem;
+  arma::mat result(p, n);
+
+  #pragma omp parallel for schedule(static)
+  for (int i=0; i < (int) n; i++) {
+    const double* Qi = Qt.colptr(i);
+    const double* qi = qt.colptr(i);
+    double* out = result.colptr(i);
+    arma::uword j = 0;
+    for (arma::uword k=0; k < p; k++) {
+      double y = x(k);
+      if (!(y >= Qi[0] && y <= Qi[m - 1])) {
+        out[k] = 0;
+        continue;
+      }
+      while (Qi[j + 1] < y)
+        j++;
+      double width = Qi[j + 1] - Qi[j];
+      double lambda = width > 0 ? (y - Qi[j]) / width : 0;
+      out[k] = (1 - lambda) / qi[j] + lambda / qi[j + 1];
+    }
+  }
+  return result.t();
+}
+
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+// GlycemicMetrics.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _GLYCEMIC_METRICS_H // include guard
+#define _GLYCEMIC_METRICS_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "TimeWindows.h"
+
+
+namespace bio {
+
+/**
+ * Glycemic metrics computed by glycemic_metrics, in the order of its columns. The names follow
+ * those of the clinical variables of Hall et al. (2018). Values are in mg/dL, slopes in mg/dL
+ * per hour and percentages over the readings.
+ */
+const char* const GLYCEMIC_METRICS[] = {
+  "mean_glucose", "sd_glucose", "range_glucose", "min_glucose", "max_glucose", "quartile.25_glucose",
+  "median_glucose", "quartile.75_glucose", "IQR", "se_glucose_mean", "coef_variation", "j_index",
+  "mean_slope", "max_slope", "number_Random140", "number_Random200", "percent_below.70",
+  "percent_below.80", "percent_in.70_180", "percent_above.130", "percent_above.180", "numGE", "mage",
+  "modd", "distance_traveled", "number_Random140_normByDays", "number_Random200_normByDays",
+  "numGE_normByDays", "distance_traveled_normByDays"
+};
+const arma::uword GLYCEMIC_COUNT = sizeof(GLYCEMIC_METRICS) / sizeof(GLYCEMIC_METRICS[0]);
+
+/**
+ * Readings used for the difference between days (MODD) are those closer than this to 24 hours
+ * before a reading, in seconds.
+ */
+const double MODD_TOLERANCE = 300;
+
+/**
+ * Quantile of type 7 (the default of stats::quantile) of sorted values.
+ */
+inline double sorted_quantile(const std::vector<double>& x, const double p) {
+  double h = (x.size() - 1) * p;
+  size_t lo = (size_t) std::floor(h);
+  size_t hi = std::min(lo + 1, x.size() - 1);
+  return x[lo] + (h - lo) * (x[hi] - x[lo]);
+}
+
+
+/**
+ * This function computes the standard glycemic metrics of continuous glucose monitoring from
+ * the raw series of each subject, in parallel across subjects. Moments, ranges, thresholds,
+ * slopes, the excursions between turning points and the differences with the readings of the
+ * previous day are accumulated in a single pass over the readings sorted by time; quantiles
+ * are then taken from a sorted copy of the values. Glycemic excursions (numGE, MAGE) are the
+ * rises and falls between consecutive turning points larger than one standard deviation. MODD
+ * is the mean absolute difference between readings 24 hours apart. Counts per day divide by
+ * the time between the first and last readings.
+ * Inputs:
+ *   id     - 0-based subject index of each reading
+ *   time   - seconds since 1970-01-01 00:00:00 UTC of each reading
+ *   value  - the readings, in mg/dL
+ *   groups - number of subjects
+ * Outputs:
+ *   A groups x GLYCEMIC_COUNT matrix with the metrics of each subject (see GLYCEMIC_METRICS).
+ *   Metrics that are undefined for a subject, for example with less than two readings, are NaN.
+ */
+inline arma::mat glycemic_metrics(const arma::uvec& id, const arma::vec& time, const arma::vec& value,
+                                  const arma::uword groups) {
+  arma::uvec offsets;
+  std::vector<std::pair<double, double> > readings;
+  group_by_time(id, time, value, groups, offsets, readings);
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  arma::mat result(groups, GLYCEMIC_COUNT);
+  result.fill(nan);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++) {
+    const std::pair<double, double>* r = readings.data() + offsets(g);
+    arma::uword n = offsets(g + 1) - offsets(g);
+    if (n == 0)
+      continue;
+
+    double mean = 0, m2 = 0, lo = r[0].second, hi = r[0].second;
+    double above140 = 0, above200 = 0, below70 = 0, below80 = 0, above130 = 0, above180 = 0;
+    double distance = 0, slopes = 0, max_slope = nan, days_sum = 0;
+    arma::uword pairs = 0, days_count = 0, lag = 0;
+    std::vector<double> swings;
+    double turn = r[0].second;
+    int direction = 0;
+
+    for (arma::uword i=0; i < n; i++) {
+      double t = r[i].first, v = r[i].second;
+      double delta = v - mean;
+      mean += delta / (i + 1);
+      m2 += delta * (v - mean);
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      above140 += v > 140;
+      above200 += v > 200;
+      above130 += v > 130;
+      above180 += v > 180;
+      below70 += v < 70;
+      below80 += v < 80;
+      if (i == 0)
+        continue;
+
+      double step = v - r[i - 1].second;
+      distance += std::fabs(step);
+      double dt = t - r[i - 1].first;
+      if (dt > 0) {
+        double slope = std::fabs(step) / dt * 3600;
+        slopes += slope;
+        max_slope = pairs == 0 ? slope : std::max(max_slope, slope);
+        pairs++;
+      }
+
+      // a turning point closes the rise or fall that ended at the previous reading
+      int sign = (step > 0) - (step < 0);
+      if (sign != 0 && sign != direction) {
+        if (direction != 0) {
+          swings.push_back(std::fabs(r[i - 1].second - turn));
+          turn = r[i - 1].second;
+        }
+        direction = sign;
+      }
+
+      // reading closest to 24 hours before
+      double target = t - SECONDS_PER_DAY;
+      while (lag + 1 < i && r[lag + 1].first <= target)
+        lag++;
+      arma::uword k = lag + 1 < i && r[lag + 1].first - target < target - r[lag].first ? lag + 1 : lag;
+      if (std::fabs(r[k].first - target) <= MODD_TOLERANCE) {
+        days_sum += std::fabs(v - r[k].second);
+        days_count++;
+      }
+    }
+    if (direction != 0)
+      swings.push_back(std::fabs(r[n - 1].second - turn));
+
+    std::vector<double> sorted(n);
+    for (arma::uword i=0; i < n; i++)
+      sorted[i] = r[i].second;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sd = n > 1 ? std::sqrt(m2 / (n - 1)) : nan;
+    double excursions = 0, amplitude = 0;
+    for (size_t s=0; s < swings.size(); s++) {
+      if (swings[s] > sd) {
+        excursions++;
+        amplitude += swings[s];
+      }
+    }
+    double days = (r[n - 1].first - r[0].first) / SECONDS_PER_DAY;
+    double q1 = sorted_quantile(sorted, 0.25), q3 = sorted_quantile(sorted, 0.75);
+
+    double metrics[] = {
+      mean, sd, hi - lo, lo, hi, q1,
+      sorted_quantile(sorted, 0.5), q3, q3 - q1, sd / std::sqrt((double) n), sd / mean, 0.001 * (mean + sd) * (mean + sd),
+      pairs > 0 ? slopes / pairs : nan, max_slope, above140, above200, 100 * below70 / n,
+      100 * below80 / n, 100 * (n - below70 - above180) / n, 100 * above130 / n, 100 * above180 / n,
+      n > 1 ? excursions : nan, excursions > 0 ? amplitude / excursions : nan,
+      days_count > 0 ? days_sum / days_count : nan, distance,
+      days > 0 ? above140 / days : nan, days > 0 ? above200 / days : nan,
+      days > 0 && n > 1 ? excursions / days : nan, days > 0 ? distance / days : nan
+    };
+    for (arma::uword j=0; j < GLYCEMIC_COUNT; j++)
+      result(g, j) = metrics[j];
+  }
+  return result;
+}
+
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+// HashJoin.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HASH_JOIN_H // include guard
+#define _HASH_JOIN_H
+
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <RcppArmadillo.h>
+
+
+namespace bio {
+
+struct join_struct {
+  arma::uvec rows;        // rows of the right table, in the order of the left keys
+  arma::uvec unmatched;   // left keys without any row
+  arma::uvec duplicated;  // rows of the right table whose id appears more than once
+};
+
+
+/**
+ * This function joins a table to an ordered list of keys in linear time. The rows of the table
+ * are indexed by id in a hash table, with the rows that share an id chained in their original
+ * order, and then emitted key by key. As with which(ids == key) for each key, a key with several
+ * rows contributes all of them and a key without rows contributes none.
+ * Inputs:
+ *   keys - the keys in output order (for example, the subjects of the functional data)
+ *   ids  - the id of each row of the table (for example, the covariates)
+ * Outputs:
+ *   The 0-based rows of the table in key order, the 0-based positions of the keys without rows,
+ *   and the 0-based rows whose id is repeated in the table.
+ */
+inline join_struct join_ids(const std::vector<std::string>& keys, const std::vector<std::string>& ids) {
+  const arma::uword none = (arma::uword) -1;
+  arma::uword n = ids.size();
+
+  // head of the chain of rows of each id, and the next row with the same id
+  std::unordered_map<std::string, arma::uword> head;
+  head.reserve(n);
+  std::vector<arma::uword> next(n, none);
+  std::vector<arma::uword> tail(n, none);
+  std::vector<char> repeated(n, 0);
+  for (arma::uword i=0; i < n; i++) {
+    std::pair<std::unordered_map<std::string, arma::uword>::iterator, bool> it = head.emplace(ids[i], i);
+    if (it.second) {
+      tail[i] = i;
+    } else {
+      arma::uword first = it.first->second;
+      next[tail[first]] = i;
+      tail[first] = i;
+      repeated[first] = 1;
+      repeated[i] = 1;
+    }
+  }
+
+  std::vector<arma::uword> rows, unmatched;
+  rows.reserve(std::min((size_t) n, keys.size()));
+  for (arma::uword k=0; k < keys.size(); k++) {
+    std::unordered_map<std::string, arma::uword>::const_iterator it = head.find(keys[k]);
+    if (it == head.end()) {
+      unmatched.push_back(k);
+      continue;
+    }
+    for (arma::uword i=it->second; i != none; i = next[i])
+      rows.push_back(i);
+  }
+
+  std::vector<arma::uword> duplicated;
+  for (arma::uword i=0; i < n; i++) {
+    if (repeated[i])
+      duplicated.push_back(i);
+  }
+
+  join_struct result;
+  result.rows = arma::uvec(rows);
+  result.unmatched = arma::uvec(unmatched);
+  result.duplicated = arma::uvec(duplicated);
+  return result;
+}
+
+
+}
+
+#endif
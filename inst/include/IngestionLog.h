@@ -0,0 +1,275 @@
+// IngestionLog.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _INGESTION_LOG_H // include guard
+#define _INGESTION_LOG_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "CsvReader.h"
+#include "QuantileGrid.h"
+#include "QuantileSketch.h"
+#include "StreamingReader.h"
+
+
+namespace bio {
+
+/**
+ * Sidecar of an append-only ingestion. The log records, for each csv file read, the offset up
+ * to which it was read and a hash of its first bytes; the cleaning options and the sketch
+ * accuracy the readings were ingested with; the per-subject sketches; and the last quantile
+ * matrix computed from them, with its grid. The file is written next to its destination and
+ * renamed at the end. On POSIX the rename is atomic, so a log is either the previous one or
+ * the new one; on Windows the previous log is removed first, so a crash in between leaves no
+ * log and the next run reads the files again.
+ *
+ *   header   - magic "BIOLOG01", byte order mark
+ *   options  - k, sentinels and their substitutes, range of valid values
+ *   files    - path, offset and prefix hash of each file
+ *   sketches - see sketch_set::write
+ *   cache    - grid and quantile matrix (one row per subject of the sketches, in their order)
+ */
+const uint32_t LOG_BOM = 0x01020304;
+const uint64_t LOG_PREFIX = 65536;
+
+struct log_file {
+  std::string path;
+  uint64_t offset;   // bytes read
+  uint64_t hash;     // hash of the first min(offset, LOG_PREFIX) bytes
+};
+
+struct ingest_struct {
+  stream_struct stream;   // totals of the rows read in this run
+  bool rebuilt;           // the log was missing or could not be extended
+  arma::uvec updated;     // 0-based subjects whose quantiles were recomputed
+  arma::vec grid;
+  arma::mat quantiles;
+};
+
+/**
+ * FNV-1a hash of the first bytes of a file, and the size of the file. A file that cannot be
+ * opened has size 0.
+ */
+inline uint64_t file_prefix_hash(const std::string& filename, const uint64_t bytes, uint64_t& size) {
+  std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+  if (!in) {
+    size = 0;
+    return 0;
+  }
+  size = in.tellg();
+  in.seekg(0);
+  std::vector<char> buffer(std::min(bytes, size));
+  in.read(buffer.data(), buffer.size());
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i=0; i < buffer.size(); i++) {
+    hash ^= (unsigned char) buffer[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+inline void write_options(std::ostream& out, const arma::uword k, const csv_options& options) {
+  write_value<uint64_t>(out, k);
+  write_value<uint64_t>(out, options.sentinels.size());
+  for (size_t i=0; i < options.sentinels.size(); i++) {
+    write_string(out, options.sentinels[i]);
+    write_value<double>(out, options.substitutes[i]);
+  }
+  write_value<double>(out, options.min);
+  write_value<double>(out, options.max);
+}
+
+/**
+ * Whether the options serialized in the stream are those of this ingestion.
+ */
+inline bool same_options(std::istream& in, const arma::uword k, const csv_options& options) {
+  std::ostringstream expected;
+  write_options(expected, k, options);
+  std::string bytes = expected.str();
+  std::string found(bytes.size(), '\0');
+  in.read(&found[0], found.size());
+  return in && found == bytes;
+}
+
+
+/**
+ * This function reads a set of csv files that only grow by appending rows, and keeps their
+ * readings in per-subject sketches (see load_data_stream). When the log of a previous run is
+ * found, only the bytes appended since then are parsed and only the quantile functions of the
+ * subjects that received readings are recomputed; files not read before are read in full. The
+ * log is discarded and the files are read again from the start when it was written with other
+ * options, or when a file is shorter than logged or its first bytes changed. The updated log
+ * is written back at the end.
+ * Inputs:
+ *   filenames   - csv files (see read_csv)
+ *   logname     - path of the log
+ *   chunk_bytes - size of the chunk buffer (see stream_csv)
+ *   sketches    - empty set of sketches that receives the readings
+ *   threads     - number of threads used to parse each chunk (0 uses the OpenMP default)
+ *   options     - cleaning of the values
+ *   t           - grid of probabilities, used when tol is not positive
+ *   tol         - tolerance of an adaptive grid built from the sketches (see refine_grid)
+ *   min_points  - smallest number of points of the adaptive grid
+ *   max_points  - largest number of points of the adaptive grid
+ *   resolution  - number of intervals of the quantiles the adaptive grid is refined on
+ * Outputs:
+ *   The totals of the rows read, whether the log was rebuilt, the subjects updated, and the
+ *   grid and quantiles of every subject.
+ */
+inline ingest_struct ingest_files(const std::vector<std::string>& filenames, const std::string& logname,
+                                  const size_t chunk_bytes, sketch_set& sketches, const int threads,
+                                  const csv_options& options, const arma::vec& t, const double tol,
+                                  const int min_points, const int max_points, const int resolution) {
+  std::vector<log_file> files;
+  arma::vec cached_grid;
+  arma::mat cached;
+  ingest_struct result;
+  result.rebuilt = true;
+
+  std::ifstream in(logname.c_str(), std::ios::binary);
+  char magic[8];
+  if (in && in.read(magic, 8) && memcmp(magic, "BIOLOG01", 8) == 0 && read_value<uint32_t>(in) == LOG_BOM &&
+      same_options(in, sketches.k(), options)) {
+    uint64_t n = read_value<uint64_t>(in);
+    files.resize(n);
+    bool valid = true;
+    for (uint64_t i=0; i < n; i++) {
+      files[i].path = read_string(in);
+      files[i].offset = read_value<uint64_t>(in);
+      files[i].hash = read_value<uint64_t>(in);
+      uint64_t size;
+      uint64_t hash = file_prefix_hash(files[i].path, std::min(files[i].offset, LOG_PREFIX), size);
+      if (size < files[i].offset || hash != files[i].hash)
+        valid = false;
+    }
+    if (valid) {
+      sketches.read(in);
+      uint64_t m = read_value<uint64_t>(in);
+      uint64_t rows = read_value<uint64_t>(in);
+      if (rows != sketches.size())
+        throw std::invalid_argument("The ingestion log " + logname + " is corrupted");
+      cached_grid.set_size(m);
+      cached.set_size(rows, m);
+      in.read(reinterpret_cast<char*>(cached_grid.memptr()), m * sizeof(double));
+      in.read(reinterpret_cast<char*>(cached.memptr()), rows * m * sizeof(double));
+      if (!in)
+        throw std::invalid_argument("The ingestion log " + logname + " is truncated");
+      result.rebuilt = false;
+    }
+  }
+  in.close();
+  if (result.rebuilt) {
+    files.clear();
+    sketches = sketch_set(sketches.k());
+  }
+
+  // subjects whose count changes receive new readings
+  std::vector<uint64_t> before(sketches.size());
+  for (arma::uword i=0; i < sketches.size(); i++)
+    before[i] = sketches.sketch(i).count();
+
+  stream_struct& total = result.stream;
+  total.rows = total.rejected = total.chunks = total.bytes = 0;
+  total.seconds = 0;
+  for (size_t f=0; f < filenames.size(); f++) {
+    size_t i = 0;
+    while (i < files.size() && files[i].path != filenames[f])
+      i++;
+    if (i == files.size()) {
+      log_file file = {filenames[f], 0, 0};
+      files.push_back(file);
+    }
+    stream_struct s = stream_csv(filenames[f], chunk_bytes, sketches, threads, options, files[i].offset, "", true);
+    total.bytes += s.bytes - files[i].offset;
+    total.rows += s.rows;
+    total.rejected += s.rejected;
+    total.chunks += s.chunks;
+    total.seconds += s.seconds;
+    uint64_t size;
+    files[i].offset = s.bytes;
+    files[i].hash = file_prefix_hash(filenames[f], std::min(s.bytes, LOG_PREFIX), size);
+  }
+  total.rows_per_second = total.seconds > 0 ? total.rows / total.seconds : 0;
+
+  result.grid = t;
+  if (tol > 0)
+    result.grid = refine_grid(sketches.quantiles(arma::linspace(0, 1, resolution + 1)), tol, min_points,
+                              max_points);
+  bool reuse = cached_grid.n_elem == result.grid.n_elem &&
+    std::equal(cached_grid.memptr(), cached_grid.memptr() + cached_grid.n_elem, result.grid.memptr());
+
+  arma::uword n = sketches.size();
+  std::vector<arma::uword> updated;
+  for (arma::uword i=0; i < n; i++) {
+    if (!reuse || i >= before.size() || sketches.sketch(i).count() != before[i])
+      updated.push_back(i);
+  }
+  result.updated = arma::uvec(updated);
+  result.quantiles.set_size(n, result.grid.n_elem);
+  if (reuse) {
+    for (arma::uword j=0; j < result.grid.n_elem; j++)
+      std::copy(cached.colptr(j), cached.colptr(j) + cached.n_rows, result.quantiles.colptr(j));
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int u=0; u < (int) updated.size(); u++)
+    sketches.sketch(updated[u]).quantiles(result.grid, result.quantiles.memptr() + updated[u], n);
+
+  std::string tmp = logname + ".tmp";
+  {
+    std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+      throw std::invalid_argument("Unable to create file " + tmp);
+    out.write("BIOLOG01", 8);
+    write_value<uint32_t>(out, LOG_BOM);
+    write_options(out, sketches.k(), options);
+    write_value<uint64_t>(out, files.size());
+    for (size_t i=0; i < files.size(); i++) {
+      write_string(out, files[i].path);
+      write_value<uint64_t>(out, files[i].offset);
+      write_value<uint64_t>(out, files[i].hash);
+    }
+    sketches.write(out);
+    write_value<uint64_t>(out, result.grid.n_elem);
+    write_value<uint64_t>(out, n);
+    out.write(reinterpret_cast<const char*>(result.grid.memptr()), result.grid.n_elem * sizeof(double));
+    out.write(reinterpret_cast<const char*>(result.quantiles.memptr()), result.quantiles.n_elem * sizeof(double));
+    if (!out)
+      throw std::runtime_error("Error while writing file " + tmp);
+  }
+#ifdef _WIN32
+  remove(logname.c_str());
+#endif
+  if (rename(tmp.c_str(), logname.c_str()) != 0)
+    throw std::runtime_error("Unable to rename " + tmp + " to " + logname);
+  return result;
+}
+
+
+}
+
+#endif
@@ -22,7 +22,9 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <vector>
 #include <RcppArmadillo.h>
+#include "QuantileGrid.h"
 
 
 namespace bio {
@@ -37,29 +39,19 @@ struct nadaraya_struct {
 };
 
 
-inline arma::mat trapecio(arma::mat X, arma::mat Y) {
+/**
+ * Integral of the points Y with respect to the coordinates X by the trapezoid rule (see
+ * cumulative_trapezoid). X and Y are vectors of the same dimension; the result is 1x1.
+ */
+inline arma::mat trapecio(const arma::mat& X, const arma::mat& Y) {
   if (X.n_rows != Y.n_rows || X.n_cols != Y.n_cols)
     throw std::invalid_argument("Arguments 'x' and 'y' must be matrices of the same dimension");
-  bool transposed = false;
-  arma::uword m = 1;
-  if (X.n_cols == 1) {
-    transposed = true;
-  } else {
-    X = X.t();
-    Y = Y.t();
-  }
-
-  arma::uword n = X.n_rows;
-  arma::mat C = arma::zeros(n,m);
-  arma::mat tmp = (X.rows(1,n-1) - X.rows(0,n-2)) % (Y.rows(1,n-1) + Y.rows(0,n-2));
-  arma::mat result;
-  if (tmp.n_rows == 1) {
-    C.row(1) = 0.5 * tmp;
-    result = C.row(n-1);
-  } else {
-    C.rows(1,n-1) = 0.5 * cumsum(tmp);
-    result = C.row(n-1);
-  }
+  arma::uword n = X.n_elem;
+  std::vector<double> C(n);
+  cumulative_trapezoid(X.memptr(), n, Y.memptr(), 1, NULL, C.data());
+  arma::mat result(1, 1, arma::fill::zeros);
+  if (n > 0)
+    result(0, 0) = C[n - 1];
   return result;
 }
 
@@ -0,0 +1,460 @@
+// ProjectionSolver.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _PROJECTION_SOLVER_H // include guard
+#define _PROJECTION_SOLVER_H
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "QuantileGrid.h"
+
+
+namespace bio {
+
+/**
+ * Solvers of the quadratic program that projects a fitted quantile density onto the positive
+ * ones (see wasserstein_regression): QP_ALGLIB uses the dense interior point method of alglib
+ * (see qp_projection), QP_ADMM the structured solver below.
+ */
+enum qp_backend {QP_ALGLIB = 0, QP_ADMM = 1};
+
+/**
+ * Suffix sums of the quadratic program of the grid t: S(l) is the sum of (d(k) + d(k+1)) / 2
+ * for k = max(0, l-1), ..., m-3, where d are the spacings of t (see getcC).
+ */
+inline arma::vec qp_suffix_sums(const arma::vec& t) {
+  arma::uword m = t.n_elem;
+  arma::vec S(m, arma::fill::zeros);
+  for (arma::uword l = m - 1; l-- > 1; )
+    S(l) = S(l + 1) + 0.5 * (t(l + 1) - t(l - 1));
+  S(0) = S(1);
+  return S;
+}
+
+
+/**
+ * Cholesky factorization of a symmetric positive definite band matrix with p subdiagonals,
+ * stored by rows: band[i * (p + 1) + k] holds the element (i, i - k). The factor overwrites the
+ * band. Returns false if the matrix is not positive definite.
+ */
+inline bool band_cholesky(std::vector<double>& band, const arma::uword n, const arma::uword p) {
+  for (arma::uword i=0; i < n; i++) {
+    arma::uword first = i > p ? i - p : 0;
+    for (arma::uword j=first; j <= i; j++) {
+      double sum = band[i * (p + 1) + (i - j)];
+      for (arma::uword k=std::max(first, j > p ? j - p : 0); k < j; k++)
+        sum -= band[i * (p + 1) + (i - k)] * band[j * (p + 1) + (j - k)];
+      if (i == j) {
+        if (!(sum > 0))
+          return false;
+        band[i * (p + 1)] = sqrt(sum);
+      } else {
+        band[i * (p + 1) + (i - j)] = sum / band[j * (p + 1)];
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Solves LL'x = b in place, with L a band Cholesky factor (see band_cholesky).
+ */
+inline void band_solve(const std::vector<double>& band, const arma::uword n, const arma::uword p, double* x) {
+  for (arma::uword i=0; i < n; i++) {
+    for (arma::uword k=1; k <= std::min(i, p); k++)
+      x[i] -= band[i * (p + 1) + k] * x[i - k];
+    x[i] /= band[i * (p + 1)];
+  }
+  for (arma::uword i=n; i-- > 0; ) {
+    for (arma::uword k=1; k <= std::min(n - 1 - i, p); k++)
+      x[i] -= band[(i + k) * (p + 1) + k] * x[i + k];
+    x[i] /= band[i * (p + 1)];
+  }
+}
+
+
+/**
+ * Structured solver of the projection of wasserstein_regression,
+ *
+ *   min x'Dx/2 + d'x  s.t.  q >= qdmin,  |q(i) - q(i+1)| <= v(i),
+ *
+ * with x = (Q0, q) and D = [1 c'; c C] the matrices of getcC. D is dense, but in the cumulative
+ * variables Y(0) = Q0, Y(l+1) = Q0 + w(0) q(0) + ... + w(l) q(l), with w the trapezoid weights
+ * of t, it is the diagonal matrix diag(0, h(0) - h(1), ..., h(m-1) - h(m)), h(l) = d(K)/10 + S(l)
+ * and h(m) = 0, plus the entries (0, 0) and (0, m), which follow from the last interval of the
+ * grid. The constraints are banded in x, so after the change of variables the system of each
+ * iteration of ADMM is a band matrix with two subdiagonals plus a rank-2 correction, solved by a
+ * band Cholesky factorization and the Woodbury identity in O(m).
+ *
+ * The iteration is the one of OSQP: variables and constraints are scaled to unit diagonal and
+ * unit rows, the steps are over-relaxed and the penalty rho is adapted to balance the primal
+ * and dual residuals, refactoring when it changes by more than a factor of 5. The factorization
+ * for the initial rho is built once and shared by all the solves, so solves can run in parallel.
+ */
+class admm_projection {
+public:
+  /**
+   * Inputs:
+   *   t        - grid vector on [0,1], strictly increasing
+   *   qdmin    - lower bound of the quantile density
+   *   eps      - absolute and relative tolerance of the residuals
+   *   max_iter - maximum number of iterations of a solve
+   * Throws std::invalid_argument if t is not strictly increasing or the program is far from
+   * convex on it.
+   */
+  admm_projection(const arma::vec& t, const double qdmin, const double eps = 1e-5, const arma::uword max_iter = 20000) :
+      m(t.n_elem), n(t.n_elem + 1), qdmin(qdmin), eps(eps), max_iter(max_iter) {
+    if (m < 3)
+      throw std::invalid_argument("The grid t must have at least three points");
+    w = trapezoid_weights(t);
+    for (arma::uword i=0; i < m; i++) {
+      if (!(w(i) > 0))
+        throw std::invalid_argument("The grid t must be strictly increasing");
+    }
+
+    double dK = t(m - 1) - t(m - 2);
+    arma::vec S = qp_suffix_sums(t);
+    diag.zeros(n);
+    for (arma::uword l=0; l < m; l++) {
+      double h = 0.1 * dK + S(l);
+      double next = l + 1 < m ? 0.1 * dK + S(l + 1) : 0;
+      diag(l + 1) = h - next;
+    }
+    corner = 1 - (0.1 * dK + S(0)) - 0.8 * dK;
+    cross = 0.4 * dK;
+
+    // scaling of the variables to the unit diagonal of D, and of the constraints to unit rows
+    scale.set_size(n);
+    scale(0) = 1;
+    for (arma::uword i=0; i < m; i++)
+      scale(i + 1) = 1 / (w(i) * sqrt(0.1 * dK + S(i)));
+    row.set_size(2 * m - 1);
+    for (arma::uword i=0; i < m; i++)
+      row(i) = 1 / scale(i + 1);
+    for (arma::uword i=0; i + 1 < m; i++)
+      row(m + i) = 1 / sqrt(scale(i + 1) * scale(i + 1) + scale(i + 2) * scale(i + 2));
+
+    // D is not convex on every grid: the solver is only used when the smallest eigenvalue of the
+    // scaled D is above -CONVEXITY_TOL, that is, when the scaled D + CONVEXITY_TOL I is positive
+    // definite, the system of factorize for rho = 0 and sigma = CONVEXITY_TOL
+    std::vector<double> check;
+    if (!factorize(0, CONVEXITY_TOL, check))
+      throw std::invalid_argument("The quadratic program of the grid t is not convex");
+
+    // the system of each iteration is positive definite for a large enough rho
+    rho0 = 0.1;
+    while (!factorize(rho0, SIGMA, factor0)) {
+      rho0 *= 5;
+      if (rho0 > 1e6)
+        throw std::runtime_error("Unable to factorize the projection system");
+    }
+  }
+
+  /**
+   * Solves the program with linear term d and bounds v of the differences, starting from x0 if
+   * it is not empty. Throws std::runtime_error if it does not converge or the iterates are not
+   * finite.
+   */
+  arma::vec solve(const arma::vec& d, const arma::vec& v, const arma::vec& x0 = arma::vec()) const {
+    if (d.n_elem != n || v.n_elem != m - 1 || (!x0.is_empty() && x0.n_elem != n))
+      throw std::invalid_argument("Non-conformant quadratic program");
+    const arma::uword p = 2 * m - 1;
+    const double alpha = 1.6;
+    const double sigma = SIGMA;
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // scaled problem: x = S xs, rows of A and their bounds multiplied by E
+    std::vector<double> ds(n), lo(p), up(p);
+    for (arma::uword j=0; j < n; j++)
+      ds[j] = scale(j) * d(j);
+    for (arma::uword i=0; i < m; i++) {
+      lo[i] = row(i) * qdmin;
+      up[i] = inf;
+    }
+    for (arma::uword i=0; i + 1 < m; i++) {
+      lo[m + i] = - row(m + i) * v(i);
+      up[m + i] = row(m + i) * v(i);
+    }
+
+    std::vector<double> x(n, 0), z(p), y(p, 0), xt(n), zt(p), rhs(n), Px(n), Aty(n);
+    if (!x0.is_empty()) {
+      for (arma::uword j=0; j < n; j++)
+        x[j] = x0(j) / scale(j);
+    }
+    multiply_A(x.data(), z.data());
+    for (arma::uword i=0; i < p; i++)
+      z[i] = std::min(std::max(z[i], lo[i]), up[i]);
+
+    double rho = rho0;
+    std::vector<double> factor;
+    const std::vector<double>* L = &factor0;
+    for (arma::uword iter=1; iter <= max_iter; iter++) {
+      // (P + sigma I + rho A'A) xt = sigma x - ds + A'(rho z - y)
+      for (arma::uword i=0; i < p; i++)
+        zt[i] = rho * z[i] - y[i];
+      multiply_At(zt.data(), rhs.data());
+      for (arma::uword j=0; j < n; j++)
+        rhs[j] += sigma * x[j] - ds[j];
+      solve_system(*L, rhs.data(), xt.data());
+      multiply_A(xt.data(), zt.data());
+
+      for (arma::uword j=0; j < n; j++)
+        x[j] = alpha * xt[j] + (1 - alpha) * x[j];
+      for (arma::uword i=0; i < p; i++) {
+        double relaxed = alpha * zt[i] + (1 - alpha) * z[i];
+        double projected = std::min(std::max(relaxed + y[i] / rho, lo[i]), up[i]);
+        y[i] += rho * (relaxed - projected);
+        z[i] = projected;
+      }
+
+      if (iter % 10 != 0)
+        continue;
+
+      // residuals of the unscaled problem
+      multiply_A(x.data(), zt.data());
+      multiply_P(x.data(), Px.data());
+      multiply_At(y.data(), Aty.data());
+      // std::max drops NaN, so a diverged iterate is detected on the sum of its values
+      double primal = 0, ax = 0, az = 0, sum = 0;
+      for (arma::uword i=0; i < p; i++) {
+        sum += zt[i] + z[i] + y[i];
+        primal = std::max(primal, fabs(zt[i] - z[i]) / row(i));
+        ax = std::max(ax, fabs(zt[i]) / row(i));
+        az = std::max(az, fabs(z[i]) / row(i));
+      }
+      double dual = 0, px = 0, aty = 0, dx = 0;
+      for (arma::uword j=0; j < n; j++) {
+        sum += Px[j] + Aty[j];
+        dual = std::max(dual, fabs(Px[j] + ds[j] + Aty[j]) / scale(j));
+        px = std::max(px, fabs(Px[j]) / scale(j));
+        aty = std::max(aty, fabs(Aty[j]) / scale(j));
+        dx = std::max(dx, fabs(d(j)));
+      }
+      double primal_scale = std::max(ax, az), dual_scale = std::max(std::max(px, aty), dx);
+      if (!std::isfinite(sum))
+        throw std::runtime_error("The ADMM projection diverged");
+      if (primal <= eps + eps * primal_scale && dual <= eps + eps * dual_scale) {
+        arma::vec result(n);
+        for (arma::uword j=0; j < n; j++) {
+          result(j) = scale(j) * x[j];
+          if (!std::isfinite(result(j)))
+            throw std::runtime_error("The ADMM projection diverged");
+        }
+        for (arma::uword i=1; i < n; i++)
+          result(i) = std::max(result(i), qdmin);
+        return result;
+      }
+
+      if (iter % 50 == 0 && primal_scale > 0 && dual_scale > 0 && dual > 0) {
+        double updated = rho * sqrt((primal / primal_scale) / (dual / dual_scale));
+        updated = std::min(std::max(updated, 1e-6), 1e6);
+        if (updated > 5 * rho || updated < 0.2 * rho) {
+          std::vector<double> refactor;
+          if (factorize(updated, SIGMA, refactor)) {
+            factor.swap(refactor);
+            L = &factor;
+            rho = updated;
+          }
+        }
+      }
+    }
+    throw std::runtime_error("The ADMM projection did not converge");
+  }
+
+private:
+  static constexpr double SIGMA = 1e-6;
+  static constexpr double CONVEXITY_TOL = 0.05;
+
+  arma::uword m;
+  arma::uword n;
+  double qdmin;
+  double eps;
+  arma::uword max_iter;
+  arma::vec w;          // trapezoid weights
+  arma::vec diag;       // diagonal of D in the cumulative variables
+  double corner;        // element (0, 0) of D in the cumulative variables
+  double cross;         // element (0, m) of D in the cumulative variables
+  arma::vec scale;      // scaling of the variables
+  arma::vec row;        // scaling of the constraints
+  double rho0;
+  std::vector<double> factor0;
+
+  // Ax of the scaled constraints: q(i), then q(i) - q(i+1)
+  void multiply_A(const double* x, double* z) const {
+    for (arma::uword i=0; i < m; i++)
+      z[i] = row(i) * scale(i + 1) * x[i + 1];
+    for (arma::uword i=0; i + 1 < m; i++)
+      z[m + i] = row(m + i) * (scale(i + 1) * x[i + 1] - scale(i + 2) * x[i + 2]);
+  }
+
+  void multiply_At(const double* y, double* x) const {
+    x[0] = 0;
+    for (arma::uword i=0; i < m; i++)
+      x[i + 1] = row(i) * y[i];
+    for (arma::uword i=0; i + 1 < m; i++) {
+      x[i + 1] += row(m + i) * y[m + i];
+      x[i + 2] -= row(m + i) * y[m + i];
+    }
+    for (arma::uword j=1; j < n; j++)
+      x[j] *= scale(j);
+  }
+
+  // Px of the scaled quadratic term, as S G'MG S x
+  void multiply_P(const double* x, double* Px) const {
+    std::vector<double> Y(n);
+    Y[0] = scale(0) * x[0];
+    for (arma::uword i=0; i < m; i++)
+      Y[i + 1] = Y[i] + w(i) * scale(i + 1) * x[i + 1];
+    std::vector<double> MY(n);
+    for (arma::uword l=0; l < n; l++)
+      MY[l] = diag(l) * Y[l];
+    MY[0] += corner * Y[0] + cross * Y[m];
+    MY[m] += cross * Y[0];
+    double suffix = 0;
+    for (arma::uword i=m; i-- > 0; ) {
+      suffix += MY[i + 1];
+      Px[i + 1] = scale(i + 1) * w(i) * suffix;
+    }
+    Px[0] = scale(0) * (suffix + MY[0]);
+  }
+
+  /**
+   * Factorizes the system for the penalty r and the regularization sigma: the band matrix
+   * diag + Ginv'N Ginv, where Ginv is the inverse of the change of variables and
+   * N = sigma S^-2 + r A'E^2 A is tridiagonal, and the Woodbury correction of the entries (0, 0)
+   * and (0, m). The layout of the factor is the band factor, then B^-1 e(0) and B^-1 e(m), then
+   * the 2x2 inverse of I + K U'B^-1 U. Returns false if the system is not positive definite:
+   * with B positive definite and det(K) < 0, B + UKU' is positive definite if and only if
+   * det(I + K U'B^-1 U) > 0.
+   */
+  bool factorize(const double r, const double sigma, std::vector<double>& factor) const {
+    const arma::uword b = 2;
+    factor.assign(n * (b + 1) + 2 * n + 4, 0.0);
+
+    // N in x, tridiagonal: N0 diagonal, N1(a) = N(a, a-1)
+    std::vector<double> N0(n), N1(n, 0.0);
+    for (arma::uword j=0; j < n; j++)
+      N0[j] = sigma / (scale(j) * scale(j));
+    for (arma::uword i=0; i < m; i++)
+      N0[i + 1] += r * row(i) * row(i);
+    for (arma::uword i=0; i + 1 < m; i++) {
+      double e2 = r * row(m + i) * row(m + i);
+      N0[i + 1] += e2;
+      N0[i + 2] += e2;
+      N1[i + 2] -= e2;
+    }
+
+    // Ginv: x0 = Y0, q(i) = (Y(i+1) - Y(i)) / w(i); row a has entries at a-1 and a
+    std::vector<double> g0(n), g1(n, 0.0);
+    g0[0] = 1;
+    for (arma::uword i=0; i < m; i++) {
+      g0[i + 1] = 1 / w(i);
+      g1[i + 1] = -1 / w(i);   // element (i+1, i)
+    }
+    std::vector<double>& band = factor;
+    for (arma::uword l=0; l < n; l++)
+      band[l * (b + 1)] = diag(l);
+    for (arma::uword a=0; a < n; a++) {
+      for (arma::uword c=(a > 0 ? a - 1 : 0); c <= std::min(a + 1, n - 1); c++) {
+        double Nac = c == a ? N0[a] : (c < a ? N1[a] : N1[c]);
+        // B(i, j) += Ginv(a, i) N(a, c) Ginv(c, j), for i in {a-1, a} and j in {c-1, c}
+        for (int di=0; di < 2; di++) {
+          if (di == 1 && a == 0)
+            continue;
+          arma::uword i = a - di;
+          double gi = di == 0 ? g0[a] : g1[a];
+          for (int dj=0; dj < 2; dj++) {
+            if (dj == 1 && c == 0)
+              continue;
+            arma::uword j = c - dj;
+            double gj = dj == 0 ? g0[c] : g1[c];
+            if (j <= i)
+              band[i * (b + 1) + (i - j)] += gi * Nac * gj;
+          }
+        }
+      }
+    }
+    if (!band_cholesky(band, n, b))
+      return false;
+
+    double* Z0 = factor.data() + n * (b + 1);
+    double* Zm = Z0 + n;
+    Z0[0] = 1;
+    Zm[m] = 1;
+    band_solve(band, n, b, Z0);
+    band_solve(band, n, b, Zm);
+
+    // H = I + K U'Z with K = [corner cross; cross 0] and U = [e(0) e(m)]
+    double H00 = 1 + corner * Z0[0] + cross * Z0[m];
+    double H01 = corner * Zm[0] + cross * Zm[m];
+    double H10 = cross * Z0[0];
+    double H11 = 1 + cross * Zm[0];
+    double det = H00 * H11 - H01 * H10;
+    if (!(det > 1e-12))
+      return false;
+    double* Hinv = Zm + n;
+    Hinv[0] = H11 / det;
+    Hinv[1] = - H01 / det;
+    Hinv[2] = - H10 / det;
+    Hinv[3] = H00 / det;
+    return true;
+  }
+
+  /**
+   * Solves (P + sigma I + rho A'A) xs = rhs with a factor of factorize: with x = S xs, the system
+   * is (D + N) x = S^-1 rhs, and with Y = Gx it is (G'MG + N) Ginv Y, so Y solves
+   * (M + Ginv'N Ginv) Y = Ginv' S^-1 rhs.
+   */
+  void solve_system(const std::vector<double>& factor, const double* rhs, double* xs) const {
+    const arma::uword b = 2;
+    std::vector<double> Y(n);
+    // Ginv' u: (Ginv'u)(l) = g0(l) u(l) + g1(l+1) u(l+1)
+    for (arma::uword l=0; l < n; l++) {
+      double ul = rhs[l] / scale(l);
+      Y[l] = (l == 0 ? 1 : 1 / w(l - 1)) * ul;
+      if (l + 1 < n)
+        Y[l] -= rhs[l + 1] / scale(l + 1) / w(l);
+    }
+    band_solve(factor, n, b, Y.data());
+
+    const double* Z0 = factor.data() + n * (b + 1);
+    const double* Zm = Z0 + n;
+    const double* Hinv = Zm + n;
+    double k0 = corner * Y[0] + cross * Y[m];
+    double km = cross * Y[0];
+    double a0 = Hinv[0] * k0 + Hinv[1] * km;
+    double am = Hinv[2] * k0 + Hinv[3] * km;
+    for (arma::uword l=0; l < n; l++)
+      Y[l] -= Z0[l] * a0 + Zm[l] * am;
+
+    xs[0] = Y[0] / scale(0);
+    for (arma::uword i=0; i < m; i++)
+      xs[i + 1] = (Y[i + 1] - Y[i]) / w(i) / scale(i + 1);
+  }
+};
+
+
+}
+
+#endif
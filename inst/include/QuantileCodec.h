@@ -0,0 +1,294 @@
+// QuantileCodec.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _QUANTILE_CODEC_H // include guard
+#define _QUANTILE_CODEC_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <RcppArmadillo.h>
+
+
+namespace bio {
+
+/**
+ * Compressed n x m matrix of quantile functions. Each row is stored as its first value and the
+ * increments between consecutive values, which are non-negative because quantile functions are
+ * non-decreasing:
+ *
+ *   CODEC_FLOAT32 - increments rounded to float. The error of a decoded value is at most
+ *                   2^-24 times the range of its row, since the increments are non-negative.
+ *   CODEC_UINT16  - values quantized to 65536 levels of the range of the row, stored as the
+ *                   increments of the integer levels. The error is at most half a level,
+ *                   range / 131070, and does not accumulate along the row.
+ *
+ * Rows are laid out in blocks of consecutive rows. Within a block the increments are stored by
+ * column, so the decode kernels update the rows of a block together with unit stride.
+ */
+enum codec_precision {CODEC_UINT16 = 2, CODEC_FLOAT32 = 4};
+
+struct codec_struct {
+  arma::vec base;                    // first value of each row
+  arma::vec scale;                   // value of a uint16 level of each row (0 for float32)
+  std::vector<unsigned char> deltas;  // blocks of increments
+  double error;                      // largest absolute error of the decoded values
+};
+
+/**
+ * A read-only view of a compressed quantile matrix whose arrays are owned by the caller.
+ */
+struct quantile_codec {
+  arma::uword n;
+  arma::uword m;
+  arma::uword block;
+  int precision;
+  const double* base;
+  const double* scale;
+  const unsigned char* deltas;
+
+  arma::uword blocks() const { return (n + block - 1) / block; }
+  arma::uword rows(const arma::uword k) const { return std::min(block, n - k * block); }
+
+  /**
+   * Decodes the rows of block k into out, column-major with rows(k) rows and m columns.
+   */
+  void decode_block(const arma::uword k, double* out) const {
+    arma::uword first = k * block;
+    arma::uword nb = rows(k);
+    const unsigned char* d = deltas + first * (m - 1) * precision;
+    for (arma::uword b=0; b < nb; b++)
+      out[b] = base[first + b];
+
+    if (precision == CODEC_UINT16) {
+      const uint16_t* code = reinterpret_cast<const uint16_t*>(d);
+      std::vector<uint32_t> level(nb, 0);
+      for (arma::uword j=1; j < m; j++) {
+        double* col = out + j * nb;
+        for (arma::uword b=0; b < nb; b++) {
+          level[b] += code[b];
+          col[b] = out[b] + scale[first + b] * level[b];
+        }
+        code += nb;
+      }
+    } else {
+      const float* inc = reinterpret_cast<const float*>(d);
+      for (arma::uword j=1; j < m; j++) {
+        double* col = out + j * nb;
+        const double* prev = col - nb;
+        for (arma::uword b=0; b < nb; b++)
+          col[b] = prev[b] + inc[b];
+        inc += nb;
+      }
+    }
+  }
+};
+
+
+/**
+ * This function compresses a matrix of quantile functions (see quantile_codec). Decreases
+ * between consecutive values within rounding (1e-9 of the range of the row) are flattened;
+ * larger ones are an error. Rows with a missing or infinite value anywhere are decoded as missing
+ * values.
+ * Inputs:
+ *   Q         - n x m matrix of quantile functions, one per row
+ *   precision - CODEC_UINT16 or CODEC_FLOAT32
+ *   block     - number of rows per block
+ * Outputs:
+ *   The first values, the scales and the increments of the rows, and the largest absolute
+ *   error of the decoded values.
+ */
+inline codec_struct encode_quantiles(const arma::mat& Q, const int precision, const arma::uword block) {
+  if (precision != CODEC_UINT16 && precision != CODEC_FLOAT32)
+    throw std::invalid_argument("The precision must be uint16 or float32");
+  if (block == 0)
+    throw std::invalid_argument("The block size must be positive");
+  if (Q.n_cols < 2)
+    throw std::invalid_argument("The quantile matrix must have at least two columns");
+
+  arma::uword n = Q.n_rows, m = Q.n_cols;
+  codec_struct result;
+  result.base.set_size(n);
+  result.scale.zeros(n);
+  result.deltas.assign(n * (m - 1) * precision, 0);
+  arma::uword blocks = (n + block - 1) / block;
+  double error = 0;
+  bool decreasing = false;
+
+  #pragma omp parallel for schedule(dynamic) reduction(max:error) reduction(||:decreasing)
+  for (int k=0; k < (int) blocks; k++) {
+    arma::uword first = k * block;
+    arma::uword nb = std::min(block, n - first);
+    unsigned char* d = result.deltas.data() + first * (m - 1) * precision;
+    for (arma::uword b=0; b < nb; b++) {
+      arma::uword i = first + b;
+      double q0 = Q(i, 0);
+      double range = Q(i, m - 1) - q0;
+      bool missing = false;
+      for (arma::uword j=0; j < m && !missing; j++)
+        missing = !std::isfinite(Q(i, j));
+      result.base(i) = missing ? std::numeric_limits<double>::quiet_NaN() : q0;
+      if (missing)
+        continue;
+      double step = precision == CODEC_UINT16 ? range / 65535 : 0;
+      result.scale(i) = step;
+
+      // running maximum of the row, so that increments are non-negative
+      double top = q0, decoded = q0;
+      uint32_t level = 0;
+      for (arma::uword j=1; j < m; j++) {
+        double q = Q(i, j);
+        if (!(q >= top - 1e-9 * range) || q > Q(i, m - 1) + 1e-9 * range) {
+          decreasing = true;
+          break;
+        }
+        if (precision == CODEC_UINT16) {
+          uint32_t next = step > 0 ? (uint32_t) std::min(65535.0, std::floor((std::max(q, top) - q0) / step + 0.5)) : 0;
+          reinterpret_cast<uint16_t*>(d)[(j - 1) * nb + b] = (uint16_t) (next - level);
+          level = next;
+          decoded = q0 + step * level;
+        } else {
+          float inc = (float) (std::max(q, top) - top);
+          reinterpret_cast<float*>(d)[(j - 1) * nb + b] = inc;
+          decoded += inc;
+        }
+        top = std::max(q, top);
+        error = std::max(error, std::fabs(decoded - q));
+      }
+    }
+  }
+  if (decreasing)
+    throw std::invalid_argument("The rows of the quantile matrix must be non-decreasing");
+  result.error = error;
+  return result;
+}
+
+
+/**
+ * This function decodes a set of rows of a compressed quantile matrix. Only the blocks that
+ * hold the requested rows are decoded.
+ * Inputs:
+ *   codec - compressed quantile matrix
+ *   rows  - 0-based rows to decode
+ * Outputs:
+ *   A matrix with the decoded rows, in the order of rows.
+ */
+inline arma::mat decode_quantiles(const quantile_codec& codec, const arma::uvec& rows) {
+  arma::uword m = codec.m;
+  arma::mat result(rows.n_elem, m);
+  std::vector<std::vector<arma::uword> > wanted(codec.blocks());
+  for (arma::uword r=0; r < rows.n_elem; r++) {
+    if (rows(r) >= codec.n)
+      throw std::invalid_argument("Row index out of range");
+    wanted[rows(r) / codec.block].push_back(r);
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int k=0; k < (int) wanted.size(); k++) {
+    if (wanted[k].empty())
+      continue;
+    arma::uword nb = codec.rows(k);
+    std::vector<double> buffer(nb * m);
+    codec.decode_block(k, buffer.data());
+    for (size_t w=0; w < wanted[k].size(); w++) {
+      arma::uword r = wanted[k][w];
+      arma::uword b = rows(r) - k * codec.block;
+      for (arma::uword j=0; j < m; j++)
+        result(r, j) = buffer[j * nb + b];
+    }
+  }
+  return result;
+}
+
+
+/**
+ * This function computes the 2-Wasserstein distances between the rows of two compressed
+ * quantile matrices on the same grid, as the weighted L2 distances between quantile
+ * functions. The matrices are streamed a block at a time, so at most two decoded blocks per
+ * thread are held in memory. When x and y are the same matrix only half of the blocks are
+ * compared.
+ * Inputs:
+ *   x, y - compressed quantile matrices with m columns
+ *   w    - 1xm integration weights of the grid (see trapezoid_weights)
+ * Outputs:
+ *   A matrix whose element (i, j) is the distance between row i of x and row j of y.
+ */
+inline arma::mat codec_distances(const quantile_codec& x, const quantile_codec& y, const arma::vec& w) {
+  if (x.m != y.m || w.n_elem != x.m)
+    throw std::invalid_argument("The quantile matrices and the weights must have the same number of columns");
+
+  arma::uword m = x.m;
+  bool symmetric = x.deltas == y.deltas && x.base == y.base && x.n == y.n && x.block == y.block;
+  arma::mat result(x.n, y.n);
+  std::vector<std::pair<arma::uword, arma::uword> > pairs;
+  for (arma::uword k=0; k < x.blocks(); k++) {
+    for (arma::uword l=symmetric ? k : 0; l < y.blocks(); l++)
+      pairs.push_back(std::make_pair(k, l));
+  }
+
+  #pragma omp parallel
+  {
+    std::vector<double> a(x.block * m), b(y.block * m), acc(x.block * y.block);
+    arma::uword current = x.blocks();
+
+    #pragma omp for schedule(dynamic)
+    for (int p=0; p < (int) pairs.size(); p++) {
+      arma::uword k = pairs[p].first, l = pairs[p].second;
+      arma::uword na = x.rows(k), nb = y.rows(l);
+      if (k != current) {
+        x.decode_block(k, a.data());
+        current = k;
+      }
+      y.decode_block(l, b.data());
+      std::fill(acc.begin(), acc.begin() + na * nb, 0.0);
+      for (arma::uword j=0; j < m; j++) {
+        const double* ac = a.data() + j * na;
+        const double* bc = b.data() + j * nb;
+        for (arma::uword i=0; i < na; i++) {
+          double* row = acc.data() + i * nb;
+          for (arma::uword h=0; h < nb; h++) {
+            double d = ac[i] - bc[h];
+            row[h] += w(j) * d * d;
+          }
+        }
+      }
+      for (arma::uword i=0; i < na; i++) {
+        for (arma::uword h=0; h < nb; h++) {
+          double d = std::sqrt(acc[i * nb + h]);
+          result(k * x.block + i, l * y.block + h) = d;
+          if (symmetric)
+            result(l * y.block + h, k * x.block + i) = d;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+
+}
+
+#endif
@@ -0,0 +1,183 @@
+// QuantileEstimation.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _QUANTILE_ESTIMATION_H // include guard
+#define _QUANTILE_ESTIMATION_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <RcppArmadillo.h>
+
+
+namespace bio {
+
+/**
+ * Readings bucketed by subject: the values of subject g are values(offsets(g)), ...,
+ * values(offsets(g+1)-1), in their original order.
+ */
+struct group_struct {
+  arma::uvec offsets;
+  arma::vec values;
+};
+
+/**
+ * Buckets the readings by subject with a counting sort. NaN readings are discarded.
+ * Inputs:
+ *   id     - 0-based subject index of each reading
+ *   value  - the readings
+ *   groups - number of subjects
+ * Outputs:
+ *   A structure with the bucket offsets and the bucketed values.
+ */
+inline group_struct group_by(const arma::uvec& id, const arma::vec& value, const arma::uword groups) {
+  if (id.n_elem != value.n_elem)
+    throw std::invalid_argument("Arguments 'id' and 'value' must have the same length");
+
+  group_struct result;
+  result.offsets.zeros(groups + 1);
+  for (arma::uword i=0; i < id.n_elem; i++) {
+    if (id(i) >= groups)
+      throw std::invalid_argument("Subject index out of range");
+    if (!std::isnan(value(i)))
+      result.offsets(id(i) + 1)++;
+  }
+  for (arma::uword g=0; g < groups; g++)
+    result.offsets(g + 1) += result.offsets(g);
+
+  std::vector<arma::uword> next(result.offsets.memptr(), result.offsets.memptr() + groups);
+  result.values.set_size(result.offsets(groups));
+  for (arma::uword i=0; i < id.n_elem; i++) {
+    if (!std::isnan(value(i)))
+      result.values(next[id(i)]++) = value(i);
+  }
+  return result;
+}
+
+
+/**
+ * Places the order statistics ranks[rlo..rhi) of x[lo..hi) in their sorted positions by
+ * recursive selection.
+ */
+inline void multiselect(double* x, arma::uword lo, arma::uword hi, const std::vector<arma::uword>& ranks,
+                        arma::uword rlo, arma::uword rhi) {
+  while (rlo < rhi && lo < hi) {
+    arma::uword mid = rlo + (rhi - rlo) / 2;
+    arma::uword k = ranks[mid];
+    std::nth_element(x + lo, x + k, x + hi);
+    multiselect(x, lo, k, ranks, rlo, mid);
+    lo = k + 1;
+    rlo = mid + 1;
+  }
+}
+
+/**
+ * Sample quantiles at the probabilities p, as computed by stats::quantile (type 7), of a sample
+ * whose order statistics are already in place (for example, a sorted sample).
+ * Inputs:
+ *   x, n - the sample (n > 0)
+ *   p    - vector of probabilities
+ *   out  - output array with the quantiles, with stride between consecutive values
+ */
+inline void sorted_quantiles(const double* x, const arma::uword n, const arma::vec& p, double* out, const arma::uword stride) {
+  for (arma::uword j=0; j < p.n_elem; j++) {
+    // 1-based positions, as in stats::quantile
+    double index = 1 + (n - 1) * p(j);
+    arma::uword lo = std::min((arma::uword) std::floor(index), n);
+    arma::uword hi = std::min((arma::uword) std::ceil(index), n);
+    double qs = x[lo - 1];
+    double h = index - lo;
+    if (h > 0 && x[hi - 1] != qs)
+      qs = (1 - h) * qs + h * x[hi - 1];
+    out[j * stride] = qs;
+  }
+}
+
+/**
+ * Sample quantiles of x at the probabilities p, as computed by stats::quantile (type 7).
+ * The array x is reordered.
+ * Inputs:
+ *   x, n - the sample
+ *   p    - vector of probabilities
+ *   out  - output array with the quantiles, with stride between consecutive values
+ */
+inline void sample_quantiles(double* x, const arma::uword n, const arma::vec& p, double* out, const arma::uword stride) {
+  arma::uword m = p.n_elem;
+  if (n == 0) {
+    for (arma::uword j=0; j < m; j++)
+      out[j * stride] = std::numeric_limits<double>::quiet_NaN();
+    return;
+  }
+
+  std::vector<arma::uword> ranks;
+  ranks.reserve(2 * m);
+  for (arma::uword j=0; j < m; j++) {
+    // 1-based positions, as in stats::quantile
+    double index = 1 + (n - 1) * p(j);
+    ranks.push_back(std::min((arma::uword) std::floor(index), n) - 1);
+    ranks.push_back(std::min((arma::uword) std::ceil(index), n) - 1);
+  }
+  std::sort(ranks.begin(), ranks.end());
+  ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+
+  // selection pays off only when few order statistics are needed
+  if (4 * ranks.size() >= n)
+    std::sort(x, x + n);
+  else
+    multiselect(x, 0, n, ranks, 0, ranks.size());
+
+  sorted_quantiles(x, n, p, out, stride);
+}
+
+
+/**
+ * This function computes the empirical quantile function of each subject on a common grid.
+ * The readings are bucketed by subject in one pass and the quantiles of each subject are then
+ * obtained by selection, in parallel across subjects.
+ * Inputs:
+ *   id     - 0-based subject index of each reading
+ *   value  - the readings
+ *   groups - number of subjects
+ *   t      - 1xm vector of probabilities
+ * Outputs:
+ *   A groups x m matrix whose row g contains the quantiles of subject g on the grid t.
+ */
+inline arma::mat quantile_matrix(const arma::uvec& id, const arma::vec& value, const arma::uword groups, const arma::vec& t) {
+  group_struct buckets = group_by(id, value, groups);
+  arma::mat result(groups, t.n_elem);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++) {
+    arma::uword begin = buckets.offsets(g);
+    arma::uword n = buckets.offsets(g + 1) - begin;
+    sample_quantiles(buckets.values.memptr() + begin, n, t, result.memptr() + g, groups);
+  }
+  return result;
+}
+
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+// QuantileGrid.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _QUANTILE_GRID_H // include guard
+#define _QUANTILE_GRID_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "QuantileEstimation.h"
+
+
+namespace bio {
+
+/**
+ * Trapezoid weights of a grid: the integral of a function f sampled on the grid t is
+ * approximated by sum(w % f(t)). Each point gets half of the spacings on either side, so the
+ * weights apply to equispaced and non-uniform grids alike.
+ * Inputs:
+ *   t - 1xm increasing grid
+ * Outputs:
+ *   A 1xm vector of weights that sum to t(m-1) - t(0).
+ */
+inline arma::vec trapezoid_weights(const arma::vec& t) {
+  arma::uword m = t.n_elem;
+  arma::vec w(m, arma::fill::zeros);
+  for (arma::uword i=0; i + 1 < m; i++) {
+    double d = 0.5 * (t(i + 1) - t(i));
+    w(i) += d;
+    w(i + 1) += d;
+  }
+  return w;
+}
+
+
+/**
+ * This function integrates cumulatively, with the trapezoid rule, the rows of a matrix sampled
+ * on a grid: C(i, 0) = base(i) and C(i, j) = C(i, j-1) + (t(j) - t(j-1)) * (Y(i, j-1) + Y(i, j)) / 2.
+ * The matrices are traversed by columns with the inner loops over rows, which vectorize, and
+ * in blocks of rows small enough that the previous column of a block stays in cache; threads
+ * take disjoint blocks of rows.
+ * Inputs:
+ *   t    - grid of m points
+ *   Y    - nxm column-major matrix whose rows are sampled on t
+ *   base - n initial values (NULL for zeros)
+ * Outputs:
+ *   C    - nxm column-major matrix with the cumulative integrals (it may not alias Y)
+ */
+inline void cumulative_trapezoid(const double* t, const arma::uword m, const double* Y, const arma::uword n,
+                                 const double* base, double* C) {
+  if (n == 0 || m == 0)
+    return;
+  const arma::uword block = 256;
+  arma::uword blocks = (n + block - 1) / block;
+
+  #pragma omp parallel for schedule(static)
+  for (int b=0; b < (int) blocks; b++) {
+    arma::uword first = b * block;
+    arma::uword nb = std::min(block, n - first);
+    double* out = C + first;
+    #pragma omp simd
+    for (arma::uword i=0; i < nb; i++)
+      out[i] = base ? base[first + i] : 0;
+    for (arma::uword j=1; j < m; j++) {
+      double h = 0.5 * (t[j] - t[j - 1]);
+      const double* prev = C + (j - 1) * n + first;
+      const double* y0 = Y + (j - 1) * n + first;
+      const double* y1 = Y + j * n + first;
+      out = C + j * n + first;
+      #pragma omp simd
+      for (arma::uword i=0; i < nb; i++)
+        out[i] = prev[i] + h * (y0[i] + y1[i]);
+    }
+  }
+}
+
+inline arma::mat cumulative_trapezoid(const arma::vec& t, const arma::mat& Y, const arma::vec& base) {
+  if (t.n_elem != Y.n_cols || base.n_elem != Y.n_rows)
+    throw std::invalid_argument("The grid and the initial values must match the columns and rows of the matrix");
+  arma::mat C(Y.n_rows, Y.n_cols);
+  cumulative_trapezoid(t.memptr(), t.n_elem, Y.memptr(), Y.n_rows, base.memptr(), C.memptr());
+  return C;
+}
+
+
+/**
+ * This function differentiates, in place, the rows of a matrix sampled on a grid, with the
+ * three-point finite differences of the grid. The grid may be non-uniform: each point uses
+ * the stencil of the spacings on either side, and the first and last points use one-sided
+ * stencils, so the differences are exact for quadratics. On an equispaced grid they reduce
+ * to the central differences. The matrix is traversed by columns, which are contiguous, so
+ * the inner loops are vectorized over rows; threads take disjoint blocks of rows.
+ * Inputs:
+ *   Q - nxm matrix whose rows are sampled on t (e.g. quantile functions)
+ *   t - 1xm increasing grid, with m >= 3
+ * Outputs:
+ *   Q holds the derivatives of its rows (e.g. quantile densities).
+ */
+inline void grid_derivative(arma::mat& Q, const arma::vec& t) {
+  arma::uword n = Q.n_rows, m = Q.n_cols;
+  if (t.n_elem != m)
+    throw std::invalid_argument("The grid must have as many points as the matrix has columns");
+  if (m < 3)
+    throw std::invalid_argument("The grid must have at least three points");
+  if (n == 0)
+    return;
+
+  // coefficients of the previous, current and next values of each point
+  arma::mat c(3, m);
+  for (arma::uword j=0; j < m; j++) {
+    arma::uword k = j == 0 ? 1 : (j == m - 1 ? m - 2 : j);
+    double h1 = t(k) - t(k - 1), h2 = t(k + 1) - t(k);
+    if (!(h1 > 0 && h2 > 0))
+      throw std::invalid_argument("The grid must be increasing");
+    if (j == 0) {
+      c(0, j) = -(2 * h1 + h2) / (h1 * (h1 + h2));
+      c(1, j) = (h1 + h2) / (h1 * h2);
+      c(2, j) = -h1 / (h2 * (h1 + h2));
+    } else if (j == m - 1) {
+      c(0, j) = h2 / (h1 * (h1 + h2));
+      c(1, j) = -(h1 + h2) / (h1 * h2);
+      c(2, j) = (h1 + 2 * h2) / (h2 * (h1 + h2));
+    } else {
+      c(0, j) = -h2 / (h1 * (h1 + h2));
+      c(1, j) = (h2 - h1) / (h1 * h2);
+      c(2, j) = h1 / (h2 * (h1 + h2));
+    }
+  }
+
+  const arma::uword block = 256;
+  arma::uword blocks = (n + block - 1) / block;
+
+  #pragma omp parallel for schedule(static)
+  for (int b=0; b < (int) blocks; b++) {
+    arma::uword first = b * block;
+    arma::uword nb = std::min(block, n - first);
+    // original values of the previous and current columns, which are overwritten
+    std::vector<double> buffer(3 * nb);
+    double* prev = buffer.data();
+    double* curr = prev + nb;
+    double* last = curr + nb;
+
+    // the last point uses columns m-3 and m-2, so it is computed first
+    const double* x0 = Q.colptr(m - 3) + first;
+    const double* x1 = Q.colptr(m - 2) + first;
+    const double* x2 = Q.colptr(m - 1) + first;
+    double a0 = c(0, m - 1), a1 = c(1, m - 1), a2 = c(2, m - 1);
+    #pragma omp simd
+    for (arma::uword i=0; i < nb; i++)
+      last[i] = a0 * x0[i] + a1 * x1[i] + a2 * x2[i];
+
+    std::copy(Q.colptr(0) + first, Q.colptr(0) + first + nb, prev);
+    std::copy(Q.colptr(1) + first, Q.colptr(1) + first + nb, curr);
+    double* out = Q.colptr(0) + first;
+    const double* next = Q.colptr(2) + first;
+    a0 = c(0, 0); a1 = c(1, 0); a2 = c(2, 0);
+    #pragma omp simd
+    for (arma::uword i=0; i < nb; i++)
+      out[i] = a0 * prev[i] + a1 * curr[i] + a2 * next[i];
+
+    for (arma::uword j=1; j + 1 < m; j++) {
+      out = Q.colptr(j) + first;
+      next = Q.colptr(j + 1) + first;
+      a0 = c(0, j); a1 = c(1, j); a2 = c(2, j);
+      #pragma omp simd
+      for (arma::uword i=0; i < nb; i++) {
+        double x = curr[i];
+        out[i] = a0 * prev[i] + a1 * x + a2 * next[i];
+        prev[i] = x;
+        curr[i] = next[i];
+      }
+    }
+    std::copy(last, last + nb, Q.colptr(m - 1) + first);
+  }
+}
+
+
+/**
+ * Squared L2 error of the linear interpolation of the curves Q between the columns a and b of
+ * the reference grid, relative to the range of each curve and averaged over the curves. Curves
+ * with a null range are ignored.
+ */
+inline double interpolation_error(const arma::mat& Q, const arma::vec& range, const arma::uword a,
+                                  const arma::uword b) {
+  arma::uword r = Q.n_cols - 1;
+  double error = 0;
+  for (arma::uword j=a + 1; j < b; j++) {
+    double h = (double) (j - a) / (b - a);
+    for (arma::uword i=0; i < Q.n_rows; i++) {
+      if (range(i) > 0) {
+        double e = (Q(i, j) - (1 - h) * Q(i, a) - h * Q(i, b)) / range(i);
+        error += e * e;
+      }
+    }
+  }
+  return error / (r * Q.n_rows);
+}
+
+
+/**
+ * This function builds a grid of probabilities adapted to a set of quantile functions. Starting
+ * from an equispaced grid, the interval with the largest interpolation error is bisected until
+ * the L2 distance between the curves and their linear interpolation on the grid, which is the
+ * Wasserstein distance between the distributions, is within tol of the range of the curves (in
+ * quadratic mean over the curves), or the grid has max_points points. Quantile functions are
+ * steep in the tails and flat in the body, so the points concentrate near 0 and 1 and a grid
+ * much smaller than an equispaced one reaches the same accuracy in the tails.
+ * Inputs:
+ *   Q          - n x (r+1) matrix of quantile functions on the equispaced reference grid j/r
+ *   tol        - tolerance of the interpolation error, relative to the range of the curves
+ *   min_points - points of the initial equispaced grid
+ *   max_points - maximum number of points of the grid
+ * Outputs:
+ *   An increasing grid that begins at 0 and ends at 1, a subset of the reference grid.
+ */
+inline arma::vec refine_grid(const arma::mat& Q, const double tol, const arma::uword min_points,
+                             const arma::uword max_points) {
+  if (Q.n_cols < 2)
+    throw std::invalid_argument("The reference grid must have at least two points");
+  if (!(tol > 0))
+    throw std::invalid_argument("The tolerance of the grid must be positive");
+  if (min_points < 2 || max_points < min_points)
+    throw std::invalid_argument("The grid must have at least two points, and min_points can not exceed max_points");
+
+  arma::uword r = Q.n_cols - 1;
+  arma::vec range = Q.col(r) - Q.col(0);
+  std::vector<arma::uword> points;
+  for (arma::uword k=0; k < min_points; k++) {
+    arma::uword j = (arma::uword) std::floor((double) k * r / (min_points - 1) + 0.5);
+    if (points.empty() || j != points.back())
+      points.push_back(j);
+  }
+
+  // intervals by decreasing interpolation error
+  typedef std::pair<double, std::pair<arma::uword, arma::uword> > interval;
+  std::priority_queue<interval> queue;
+  double total = 0;
+  std::vector<interval> initial(points.size() - 1);
+  #pragma omp parallel for schedule(dynamic)
+  for (int k=0; k < (int) initial.size(); k++)
+    initial[k] = interval(interpolation_error(Q, range, points[k], points[k + 1]),
+                          std::make_pair(points[k], points[k + 1]));
+  for (size_t k=0; k < initial.size(); k++) {
+    total += initial[k].first;
+    if (initial[k].second.second - initial[k].second.first > 1)
+      queue.push(initial[k]);
+  }
+
+  while (!queue.empty() && points.size() < max_points && total > tol * tol) {
+    interval top = queue.top();
+    queue.pop();
+    arma::uword a = top.second.first;
+    arma::uword b = top.second.second;
+    arma::uword c = a + (b - a) / 2;
+    points.push_back(c);
+    interval left(interpolation_error(Q, range, a, c), std::make_pair(a, c));
+    interval right(interpolation_error(Q, range, c, b), std::make_pair(c, b));
+    total += left.first + right.first - top.first;
+    if (c - a > 1)
+      queue.push(left);
+    if (b - c > 1)
+      queue.push(right);
+  }
+
+  std::sort(points.begin(), points.end());
+  arma::vec t(points.size());
+  for (size_t k=0; k < points.size(); k++)
+    t(k) = (double) points[k] / r;
+  t(points.size() - 1) = 1;
+  return t;
+}
+
+
+/**
+ * This function builds a grid of probabilities adapted to the empirical quantile functions of
+ * a set of subjects (see refine_grid).
+ * Inputs:
+ *   id         - 0-based subject index of each reading
+ *   value      - the readings
+ *   groups     - number of subjects
+ *   tol        - tolerance of the interpolation error, relative to the range of the subjects
+ *   min_points - points of the initial equispaced grid
+ *   max_points - maximum number of points of the grid
+ *   resolution - number of intervals of the equispaced reference grid
+ * Outputs:
+ *   An increasing grid that begins at 0 and ends at 1.
+ */
+inline arma::vec quantile_grid(const arma::uvec& id, const arma::vec& value, const arma::uword groups,
+                               const double tol, const arma::uword min_points, const arma::uword max_points,
+                               const arma::uword resolution) {
+  arma::vec p = arma::linspace(0, 1, resolution + 1);
+  return refine_grid(quantile_matrix(id, value, groups, p), tol, min_points, max_points);
+}
+
+
+}
+
+#endif
@@ -0,0 +1,410 @@
+// QuantileSketch.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _QUANTILE_SKETCH_H // include guard
+#define _QUANTILE_SKETCH_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "QuantileEstimation.h"
+
+
+namespace bio {
+
+/**
+ * Binary serialization of plain values in the byte order of the host.
+ */
+template <typename T>
+inline void write_value(std::ostream& out, const T& x) {
+  out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <typename T>
+inline T read_value(std::istream& in) {
+  T x;
+  if (!in.read(reinterpret_cast<char*>(&x), sizeof(T)))
+    throw std::invalid_argument("Unexpected end of a serialized sketch");
+  return x;
+}
+
+inline void write_string(std::ostream& out, const std::string& x) {
+  write_value<uint64_t>(out, x.size());
+  out.write(x.data(), x.size());
+}
+
+inline std::string read_string(std::istream& in) {
+  std::string x(read_value<uint64_t>(in), '\0');
+  if (!in.read(&x[0], x.size()))
+    throw std::invalid_argument("Unexpected end of a serialized sketch");
+  return x;
+}
+
+
+/**
+ * KLL quantile sketch. Items at level h stand for 2^h readings; a level that exceeds its
+ * capacity is sorted and every other item is promoted to the next level. Capacities decay
+ * geometrically from the top level, so the sketch keeps O(k) items and its rank error is
+ * O(1/k). The coin used by the compactions is deterministic, so equal inputs give equal
+ * sketches. Until the first compaction the sketch is exact and its quantiles coincide with
+ * stats::quantile (type 7).
+ */
+class quantile_sketch {
+public:
+  explicit quantile_sketch(const arma::uword k = 200)
+    : k_(std::max(k, (arma::uword) 8)), n_(0), size_(0), coin_(0x9E3779B97F4A7C15ULL),
+      min_(std::numeric_limits<double>::infinity()), max_(-std::numeric_limits<double>::infinity()),
+      sum_(0), sumsq_(0), levels_(1) {
+    capacity_ = capacity();
+  }
+
+  void update(const double x) {
+    if (std::isnan(x))
+      return;
+    levels_[0].push_back(x);
+    size_++;
+    n_++;
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+    sum_ += x;
+    sumsq_ += x * x;
+    if (size_ >= capacity_)
+      compress();
+  }
+
+  void merge(const quantile_sketch& other) {
+    if (other.n_ == 0)
+      return;
+    if (&other == this) {
+      // the levels can not be appended to themselves
+      quantile_sketch copy(other);
+      merge(copy);
+      return;
+    }
+    if (other.levels_.size() > levels_.size())
+      levels_.resize(other.levels_.size());
+    for (size_t h=0; h < other.levels_.size(); h++)
+      levels_[h].insert(levels_[h].end(), other.levels_[h].begin(), other.levels_[h].end());
+    size_ += other.size_;
+    n_ += other.n_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+    sumsq_ += other.sumsq_;
+    // xor would zero the state of shards with the same coin, and xorshift64 never leaves 0
+    coin_ = splitmix64(coin_ ^ splitmix64(other.coin_ + n_));
+    if (coin_ == 0)
+      coin_ = 0x9E3779B97F4A7C15ULL;
+    capacity_ = capacity();
+    while (size_ >= capacity_)
+      compress();
+  }
+
+  uint64_t count() const { return n_; }
+  double min() const { return min_; }
+  double max() const { return max_; }
+  double mean() const { return n_ > 0 ? sum_ / n_ : std::numeric_limits<double>::quiet_NaN(); }
+  double sd() const {
+    if (n_ < 2)
+      return 0;
+    double m = sum_ / n_;
+    return std::sqrt(std::max(0.0, (sumsq_ - n_ * m * m) / (n_ - 1)));
+  }
+
+  /**
+   * The retained items sorted by value, with their weights.
+   */
+  void items(std::vector<double>& x, std::vector<double>& w) const {
+    std::vector<std::pair<double, double> > all;
+    all.reserve(size_);
+    for (size_t h=0; h < levels_.size(); h++) {
+      double weight = (double) ((uint64_t) 1 << h);
+      for (size_t i=0; i < levels_[h].size(); i++)
+        all.push_back(std::make_pair(levels_[h][i], weight));
+    }
+    std::sort(all.begin(), all.end());
+    x.resize(all.size());
+    w.resize(all.size());
+    for (size_t i=0; i < all.size(); i++) {
+      x[i] = all[i].first;
+      w[i] = all[i].second;
+    }
+  }
+
+  /**
+   * Estimated quantiles at the probabilities p, interpolated between ranks as in type 7.
+   * Inputs:
+   *   p   - vector of probabilities
+   *   out - output array with the quantiles, with stride between consecutive values
+   */
+  void quantiles(const arma::vec& p, double* out, const arma::uword stride) const {
+    std::vector<double> x, w;
+    items(x, w);
+    if (x.empty()) {
+      for (arma::uword j=0; j < p.n_elem; j++)
+        out[j * stride] = std::numeric_limits<double>::quiet_NaN();
+      return;
+    }
+    // upper[i] is the number of readings with rank <= that of item i
+    std::vector<double> upper(x.size());
+    double acc = 0;
+    for (size_t i=0; i < x.size(); i++)
+      upper[i] = (acc += w[i]);
+    for (arma::uword j=0; j < p.n_elem; j++) {
+      double index = (acc - 1) * p(j);
+      double lo = std::floor(index);
+      double h = index - lo;
+      double qs = ranked(x, upper, lo);
+      if (h > 0)
+        qs = (1 - h) * qs + h * ranked(x, upper, lo + 1);
+      out[j * stride] = std::min(std::max(qs, min_), max_);
+    }
+  }
+
+  /**
+   * Writes the state of the sketch; read restores an identical sketch, so a sketch saved and
+   * restored evolves as if it had never been saved.
+   */
+  void write(std::ostream& out) const {
+    write_value<uint64_t>(out, k_);
+    write_value<uint64_t>(out, n_);
+    write_value<uint64_t>(out, coin_);
+    write_value<double>(out, min_);
+    write_value<double>(out, max_);
+    write_value<double>(out, sum_);
+    write_value<double>(out, sumsq_);
+    write_value<uint64_t>(out, levels_.size());
+    for (size_t h=0; h < levels_.size(); h++) {
+      write_value<uint64_t>(out, levels_[h].size());
+      out.write(reinterpret_cast<const char*>(levels_[h].data()), levels_[h].size() * sizeof(double));
+    }
+  }
+
+  void read(std::istream& in) {
+    k_ = read_value<uint64_t>(in);
+    n_ = read_value<uint64_t>(in);
+    coin_ = read_value<uint64_t>(in);
+    min_ = read_value<double>(in);
+    max_ = read_value<double>(in);
+    sum_ = read_value<double>(in);
+    sumsq_ = read_value<double>(in);
+    uint64_t levels = read_value<uint64_t>(in);
+    if (levels == 0 || levels > 64)
+      throw std::invalid_argument("Corrupted serialized sketch");
+    levels_.assign(levels, std::vector<double>());
+    size_ = 0;
+    for (size_t h=0; h < levels; h++) {
+      uint64_t size = read_value<uint64_t>(in);
+      if (size > 64 * k_)
+        throw std::invalid_argument("Corrupted serialized sketch");
+      levels_[h].resize(size);
+      if (!in.read(reinterpret_cast<char*>(levels_[h].data()), size * sizeof(double)))
+        throw std::invalid_argument("Unexpected end of a serialized sketch");
+      size_ += size;
+    }
+    capacity_ = capacity();
+  }
+
+private:
+  static double ranked(const std::vector<double>& x, const std::vector<double>& upper, const double rank) {
+    size_t i = std::upper_bound(upper.begin(), upper.end(), rank) - upper.begin();
+    return x[std::min(i, x.size() - 1)];
+  }
+
+  arma::uword level_capacity(const size_t h) const {
+    size_t depth = levels_.size() - 1 - h;
+    return std::max((arma::uword) 2, (arma::uword) std::ceil(k_ * std::pow(2.0 / 3.0, (double) depth)));
+  }
+
+  arma::uword capacity() const {
+    arma::uword c = 0;
+    for (size_t h=0; h < levels_.size(); h++)
+      c += level_capacity(h);
+    return c;
+  }
+
+  static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  bool flip() {
+    // xorshift64
+    coin_ ^= coin_ << 13;
+    coin_ ^= coin_ >> 7;
+    coin_ ^= coin_ << 17;
+    return coin_ & 1;
+  }
+
+  void compress() {
+    for (size_t h=0; h < levels_.size(); h++) {
+      if (levels_[h].size() < level_capacity(h))
+        continue;
+      if (h + 1 == levels_.size()) {
+        levels_.push_back(std::vector<double>());
+        capacity_ = capacity();
+      }
+      std::vector<double>& level = levels_[h];
+      std::sort(level.begin(), level.end());
+      // an odd item out stays at this level
+      size_t keep = level.size() % 2;
+      size_t offset = keep + (flip() ? 1 : 0);
+      std::vector<double>& up = levels_[h + 1];
+      for (size_t i=offset; i < level.size(); i += 2)
+        up.push_back(level[i]);
+      size_t promoted = (level.size() - keep) / 2;
+      level.resize(keep);
+      size_ -= promoted;
+      return;
+    }
+  }
+
+  arma::uword k_;
+  uint64_t n_;
+  arma::uword size_;
+  arma::uword capacity_;
+  uint64_t coin_;
+  double min_;
+  double max_;
+  double sum_;
+  double sumsq_;
+  std::vector<std::vector<double> > levels_;
+};
+
+
+/**
+ * A quantile sketch per subject, keyed by the subject identifier. Subjects keep the order in
+ * which they were first seen.
+ */
+class sketch_set {
+public:
+  explicit sketch_set(const arma::uword k = 200) : k_(k) {}
+
+  arma::uword k() const { return k_; }
+  arma::uword size() const { return ids_.size(); }
+  const std::vector<std::string>& ids() const { return ids_; }
+  const quantile_sketch& sketch(const arma::uword i) const { return sketches_[i]; }
+  quantile_sketch& sketch(const arma::uword i) { return sketches_[i]; }
+
+  arma::uword index(const std::string& id) {
+    std::unordered_map<std::string, arma::uword>::iterator it = index_.find(id);
+    if (it != index_.end())
+      return it->second;
+    arma::uword i = ids_.size();
+    index_.emplace(id, i);
+    ids_.push_back(id);
+    sketches_.push_back(quantile_sketch(k_));
+    return i;
+  }
+
+  /**
+   * Appends readings. The subjects of the readings are given as 0-based indices into ids.
+   */
+  void update(const std::vector<std::string>& ids, const arma::uvec& id, const arma::vec& value) {
+    arma::uvec target(ids.size());
+    for (size_t i=0; i < ids.size(); i++)
+      target(i) = index(ids[i]);
+    group_struct buckets = group_by(id, value, ids.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int g=0; g < (int) ids.size(); g++) {
+      quantile_sketch& s = sketches_[target(g)];
+      for (arma::uword i=buckets.offsets(g); i < buckets.offsets(g + 1); i++)
+        s.update(buckets.values(i));
+    }
+  }
+
+  /**
+   * Merges the sketches of another set (for example, the same cohort read in another shard).
+   */
+  void merge(const sketch_set& other) {
+    arma::uvec target(other.size());
+    for (arma::uword i=0; i < other.size(); i++)
+      target(i) = index(other.ids_[i]);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i=0; i < (int) other.size(); i++)
+      sketches_[target(i)].merge(other.sketches_[i]);
+  }
+
+  /**
+   * Writes the identifiers and the sketches of the subjects (see quantile_sketch::write).
+   */
+  void write(std::ostream& out) const {
+    write_value<uint64_t>(out, k_);
+    write_value<uint64_t>(out, ids_.size());
+    for (size_t i=0; i < ids_.size(); i++) {
+      write_string(out, ids_[i]);
+      sketches_[i].write(out);
+    }
+  }
+
+  void read(std::istream& in) {
+    k_ = read_value<uint64_t>(in);
+    uint64_t n = read_value<uint64_t>(in);
+    ids_.clear();
+    index_.clear();
+    sketches_.clear();
+    for (uint64_t i=0; i < n; i++) {
+      arma::uword g = index(read_string(in));
+      if (g != i)
+        throw std::invalid_argument("Corrupted serialized sketch set: repeated subject");
+      sketches_[g].read(in);
+    }
+  }
+
+  /**
+   * Quantile functions of all subjects on the grid t (one row per subject).
+   */
+  arma::mat quantiles(const arma::vec& t) const {
+    arma::uword n = sketches_.size();
+    arma::mat result(n, t.n_elem);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i=0; i < (int) n; i++)
+      sketches_[i].quantiles(t, result.memptr() + i, n);
+    return result;
+  }
+
+private:
+  arma::uword k_;
+  std::vector<std::string> ids_;
+  std::unordered_map<std::string, arma::uword> index_;
+  std::vector<quantile_sketch> sketches_;
+};
+
+
+}
+
+#endif
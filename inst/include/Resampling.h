@@ -0,0 +1,170 @@
+// Resampling.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _RESAMPLING_H // include guard
+#define _RESAMPLING_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "TimeWindows.h"
+
+
+namespace bio {
+
+/**
+ * Index of the first multiple of step not before x.
+ */
+inline int64_t next_grid_point(const double x, const double step) {
+  int64_t k = (int64_t) std::ceil(x / step);
+  while (k * step < x)
+    k++;
+  return k;
+}
+
+enum resample_method {RESAMPLE_LINEAR = 0, RESAMPLE_CONSTANT = 1};
+
+/**
+ * Series of a set of subjects resampled on a regular time grid, concatenated in subject order.
+ */
+struct resample_struct {
+  arma::uvec subject;   // 0-based subject of each point
+  arma::vec time;       // seconds since 1970-01-01 00:00:00 UTC
+  arma::vec value;
+  arma::umat counts;    // per subject: readings, duplicated timestamps, gaps, points
+};
+
+
+/**
+ * This function resamples the series of each subject on a regular time grid. Sensors sample at
+ * a nominal rate, but dropouts leave gaps and bursts or repeated uploads give readings that are
+ * closer or duplicated; computing quantiles over the raw readings weights each period by its
+ * number of readings. On a regular grid every point stands for the same time, so quantiles of
+ * the resampled values are time-weighted. Readings with the same timestamp are averaged. The
+ * grid points are the multiples of step between the first and last readings, so all subjects
+ * share them; the value at a point is interpolated between the readings on either side, unless
+ * they are farther apart than max_gap, in which case the point falls in a gap and is dropped.
+ * Each subject is processed in a single pass over its sorted readings.
+ * Inputs:
+ *   id      - 0-based subject index of each reading
+ *   time    - seconds since 1970-01-01 00:00:00 UTC of each reading
+ *   value   - the readings
+ *   groups  - number of subjects
+ *   step    - spacing of the grid, in seconds
+ *   max_gap - longest time between consecutive readings that is interpolated, in seconds
+ *   method  - RESAMPLE_LINEAR interpolates linearly; RESAMPLE_CONSTANT carries the last reading
+ * Outputs:
+ *   The resampled points of every subject and, per subject, the number of readings, duplicated
+ *   timestamps, gaps and resampled points.
+ */
+inline resample_struct resample_series(const arma::uvec& id, const arma::vec& time, const arma::vec& value,
+                                       const arma::uword groups, const double step, const double max_gap,
+                                       const int method) {
+  if (!(step > 0))
+    throw std::invalid_argument("The step of the grid must be positive");
+  if (!(max_gap >= 0))
+    throw std::invalid_argument("The maximum gap must be non-negative");
+  if (method != RESAMPLE_LINEAR && method != RESAMPLE_CONSTANT)
+    throw std::invalid_argument("Unknown resampling method");
+
+  arma::uvec offsets;
+  std::vector<std::pair<double, double> > readings;
+  group_by_time(id, time, value, groups, offsets, readings);
+  std::vector<std::vector<double> > times(groups), values(groups);
+  resample_struct result;
+  result.counts.zeros(groups, 4);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++) {
+    arma::uword first = offsets(g), last = offsets(g + 1);
+    result.counts(g, 0) = last - first;
+    if (first == last)
+      continue;
+
+    // average the readings that share a timestamp, in place
+    arma::uword n = first;
+    for (arma::uword i=first; i < last; ) {
+      arma::uword j = i + 1;
+      double sum = readings[i].second;
+      while (j < last && readings[j].first == readings[i].first)
+        sum += readings[j++].second;
+      readings[n++] = std::make_pair(readings[i].first, sum / (j - i));
+      i = j;
+    }
+    result.counts(g, 1) = last - n;
+
+    std::vector<double>& t = times[g];
+    std::vector<double>& v = values[g];
+    arma::uword a = first;
+    int64_t k = next_grid_point(readings[first].first, step);
+    double end = readings[n - 1].first;
+    for (double p = k * step; p <= end; p = (++k) * step) {
+      while (a + 1 < n && readings[a + 1].first <= p)
+        a++;
+      if (readings[a].first == p) {
+        t.push_back(p);
+        v.push_back(readings[a].second);
+        continue;
+      }
+      double gap = readings[a + 1].first - readings[a].first;
+      if (gap > max_gap) {
+        // skip to the first point after the gap
+        result.counts(g, 2)++;
+        k = next_grid_point(readings[a + 1].first, step) - 1;
+        continue;
+      }
+      double x = readings[a].second;
+      if (method == RESAMPLE_LINEAR)
+        x += (readings[a + 1].second - x) * (p - readings[a].first) / gap;
+      t.push_back(p);
+      v.push_back(x);
+    }
+    result.counts(g, 3) = t.size();
+  }
+
+  std::vector<arma::uword> offset(groups + 1, 0);
+  for (arma::uword g=0; g < groups; g++)
+    offset[g + 1] = offset[g] + times[g].size();
+  result.subject.set_size(offset[groups]);
+  result.time.set_size(offset[groups]);
+  result.value.set_size(offset[groups]);
+
+  #pragma omp parallel for schedule(static)
+  for (int g=0; g < (int) groups; g++) {
+    for (size_t i=0; i < times[g].size(); i++) {
+      result.subject(offset[g] + i) = g;
+      result.time(offset[g] + i) = times[g][i];
+      result.value(offset[g] + i) = values[g][i];
+    }
+  }
+  return result;
+}
+
+
+}
+
+#endif
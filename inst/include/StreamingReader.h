@@ -0,0 +1,200 @@
+// StreamingReader.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _STREAMING_READER_H // include guard
+#define _STREAMING_READER_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "CsvReader.h"
+#include "DensityEstimation.h"
+#include "QuantileSketch.h"
+
+
+namespace bio {
+
+struct stream_struct {
+  arma::uword rows;
+  arma::uword rejected;
+  arma::uword chunks;
+  double seconds;
+  double rows_per_second;
+  uint64_t bytes;      // offset of the end of the data read
+};
+
+
+/**
+ * This function reads a long-format csv file (see read_csv) a chunk at a time and appends the
+ * readings of each chunk to the sketches of their subjects. Only the chunk buffer and the rows
+ * parsed from it are held in memory, so files larger than the available memory can be read.
+ * Chunks end at the last complete line; the partial line left over is carried to the next chunk.
+ * Reading can resume at the offset where a previous read of a file that has since grown ended;
+ * for that, a file can be read up to its last complete line only, so a row still being written
+ * when the file is read is left for the next read instead of being parsed truncated.
+ * Inputs:
+ *   filename    - path of the csv file
+ *   chunk_bytes - size of the chunk buffer (it grows only if a single line does not fit)
+ *   sketches    - per-subject reductions that receive the readings: a sketch_set, or any set
+ *                 with the same update method (for example, a histogram_set)
+ *   threads     - number of threads used to parse each chunk (0 uses the OpenMP default)
+ *   options     - cleaning of the values
+ *   offset      - offset of the first row to read (0 reads the whole file)
+ *   subject     - id of the rows if the file has no id column (empty requires the column)
+ *   complete    - whether a last line without a line break is left unread
+ * Outputs:
+ *   The number of rows read and rejected, the number of chunks, the throughput, and the offset
+ *   of the end of the data read (with complete, the start of the line left unread).
+ */
+template <typename Set>
+inline stream_struct stream_csv(const std::string& filename, const size_t chunk_bytes, Set& sketches,
+                                int threads = 0, const csv_options& options = csv_options(),
+                                const uint64_t offset = 0, const std::string& subject = "",
+                                const bool complete = false) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if (!in)
+    throw std::invalid_argument("Unable to open file " + filename);
+
+  int nthreads = csv_threads(threads);
+  std::vector<char> buffer(std::max(chunk_bytes, (size_t) 4096));
+  size_t filled = 0;
+  bool header = false;
+  csv_layout layout;
+  uint64_t position = 0;   // offset of the start of the buffer
+  stream_struct result = {0, 0, 0, 0, 0, 0};
+
+  while (true) {
+    in.read(buffer.data() + filled, buffer.size() - filled);
+    filled += in.gcount();
+    bool eof = !in;
+    if (filled == 0)
+      break;
+
+    const char* begin = buffer.data();
+    const char* end = begin + filled;
+    const char* stop = end;
+    if (!eof || complete) {
+      while (stop > begin && stop[-1] != '\n')
+        stop--;
+      if (stop == begin) {
+        if (eof)
+          break;   // only a partial line is left
+        // a line longer than the buffer
+        buffer.resize(buffer.size() * 2);
+        continue;
+      }
+    }
+
+    if (!header) {
+      const char* body;
+      const char* header_end = csv_line_end(begin, stop, body);
+      layout = csv_header(begin, header_end, subject);
+      begin = body;
+      header = true;
+      if (offset > (uint64_t) (body - buffer.data())) {
+        // skip the rows read before
+        in.clear();
+        in.seekg(offset);
+        if (!in)
+          throw std::invalid_argument("Unable to seek to offset " + std::to_string(offset) + " of file " + filename);
+        position = offset;
+        filled = 0;
+        continue;
+      }
+    }
+
+    if (begin < stop) {
+      csv_struct chunk;
+      csv_parse_blocks(begin, stop, layout, options, nthreads, chunk);
+      sketches.update(chunk.ids, chunk.id, chunk.value);
+      result.rows += chunk.rows;
+      result.rejected += chunk.rejected;
+      result.chunks++;
+    }
+
+    filled = end - stop;
+    position += stop - buffer.data();
+    memmove(buffer.data(), stop, filled);
+    if (eof)
+      break;
+  }
+  if (!header)
+    throw std::invalid_argument("The csv file " + filename + " is empty");
+
+  result.bytes = complete ? position : position + filled;
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.rows_per_second = result.seconds > 0 ? result.rows / result.seconds : 0;
+  return result;
+}
+
+
+/**
+ * This function computes a Gaussian kernel density estimate of each subject of a set of
+ * sketches on a common equispaced grid. The retained items of each sketch are binned with
+ * their weights and convolved with the kernel by FFT (see density_matrix). The bandwidth follows
+ * stats::bw.nrd0, with the exact standard deviation of the readings and the interquartile range
+ * estimated by the sketch. While a sketch is exact the result matches density_matrix.
+ * Inputs:
+ *   sketches - per-subject sketches
+ *   t        - 1xm equispaced grid covering the range of the readings
+ * Outputs:
+ *   A n x m matrix whose row i contains the density of subject i on the grid t.
+ */
+inline arma::mat sketch_density_matrix(const sketch_set& sketches, const arma::vec& t) {
+  arma::uword m = t.n_elem;
+  if (m < 2)
+    throw std::invalid_argument("The grid t must have at least two points");
+
+  arma::uword n = sketches.size();
+  double delta = (t(m - 1) - t(0)) / (m - 1);
+  fft_plan plan(next_pow2(2 * m));
+  arma::vec p(2);
+  p(0) = 0.25;
+  p(1) = 0.75;
+  arma::mat result(n, m);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int i=0; i < (int) n; i++) {
+    const quantile_sketch& s = sketches.sketch(i);
+    std::vector<double> x, w;
+    s.items(x, w);
+    std::vector<double> bins(m, 0.0);
+    linear_binning(x.data(), w.data(), x.size(), t(0), delta, m, bins.data());
+    double q[2];
+    s.quantiles(p, q, 1);
+    double bw = s.count() > 0 ? bandwidth_nrd0(s.sd(), q[1] - q[0], s.mean(), s.count()) : 1;
+    binned_density(plan, bins.data(), m, delta, bw, result.memptr() + i, n);
+  }
+  return result;
+}
+
+
+}
+
+#endif
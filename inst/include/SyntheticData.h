@@ -0,0 +1,134 @@
+// SyntheticData.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _SYNTHETIC_DATA_H // include guard
+#define _SYNTHETIC_DATA_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "BiosensorStore.h"
+
+
+namespace bio {
+
+enum synthetic_scenario {SYNTHETIC_LINEAR = 0, SYNTHETIC_QP = 1};
+
+/**
+ * Counter-based generator of uniform numbers: the k-th number of stream i is a hash (the
+ * splitmix64 finalizer) of the seed and the counter i * width + k. Numbers can be drawn in any
+ * order and from any thread, so a cohort is the same whatever the number of threads.
+ */
+struct counter_rng {
+  uint64_t seed;
+  uint64_t width;
+
+  double uniform(const uint64_t i, const uint64_t k) const {
+    uint64_t z = seed + (i * width + k + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  double uniform(const uint64_t i, const uint64_t k, const double a, const double b) const {
+    return a + (b - a) * uniform(i, k);
+  }
+};
+
+struct synthetic_struct {
+  arma::mat X;             // nxp covariates
+  arma::mat quantiles;     // nxm quantile functions
+};
+
+
+/**
+ * This function generates a synthetic cohort from the quantile regression model
+ * Q = V + V2 * v + tau * V3 * Q0, where X ~ Unif(0, 1)^p, v = sum(2 * X), V ~ Unif(-1, 1),
+ * V2 ~ Unif(-1, 1) and V3 ~ Unif(0.8, 1.2). In the linear scenario tau = sum(2 * X), so the
+ * quantile densities are linear in the covariates. In the QP scenario tau = exp(6 * (X1 - 0.5)):
+ * the quantile densities are convex in X1, and a linear fit in X1 predicts negative quantile
+ * densities for small X1, which wasserstein_regression projects with its quadratic program.
+ * Subjects are generated in parallel, each one from its own stream of the generator.
+ * Inputs:
+ *   n        - number of subjects
+ *   Q0       - 1xm quantile function of the base distribution
+ *   p        - number of covariates
+ *   scenario - SYNTHETIC_LINEAR or SYNTHETIC_QP
+ *   seed     - seed of the generator
+ * Outputs:
+ *   The covariates and quantile functions of the subjects.
+ */
+inline synthetic_struct generate_cohort(const arma::uword n, const arma::vec& Q0, const arma::uword p,
+                                        const int scenario, const uint64_t seed) {
+  if (n == 0 || p == 0 || Q0.n_elem == 0)
+    throw std::invalid_argument("The number of subjects, covariates and quantiles must be positive");
+  if (scenario != SYNTHETIC_LINEAR && scenario != SYNTHETIC_QP)
+    throw std::invalid_argument("Unknown scenario");
+
+  arma::uword m = Q0.n_elem;
+  counter_rng rng = {seed, p + 3};
+  synthetic_struct result;
+  result.X.set_size(n, p);
+  result.quantiles.set_size(n, m);
+
+  #pragma omp parallel for schedule(static)
+  for (int i=0; i < (int) n; i++) {
+    double v = 0;
+    for (arma::uword k=0; k < p; k++) {
+      double x = rng.uniform(i, k);
+      result.X(i, k) = x;
+      v += 2 * x;
+    }
+    double tau = scenario == SYNTHETIC_QP ? std::exp(6 * (result.X(i, 0) - 0.5)) : v;
+    double V = rng.uniform(i, p, -1, 1);
+    double V2 = rng.uniform(i, p + 1, -1, 1);
+    double V3 = rng.uniform(i, p + 2, 0.8, 1.2);
+    for (arma::uword j=0; j < m; j++)
+      result.quantiles(i, j) = V + V2 * v + tau * V3 * Q0(j);
+  }
+  return result;
+}
+
+
+/**
+ * This function writes a synthetic cohort to a store file, with the sections of
+ * save_biosensor: the quantile functions, their grid t and one variables/V<k> section per
+ * covariate.
+ */
+inline void write_cohort(const std::string& filename, const synthetic_struct& cohort, const arma::vec& t) {
+  std::vector<store_section> sections;
+  sections.push_back(store_matrix("quantiles", cohort.quantiles));
+  sections.push_back(store_vector("quantiles.argvals", t.memptr(), t.n_elem));
+  for (arma::uword k=0; k < cohort.X.n_cols; k++)
+    sections.push_back(store_vector("variables/V" + std::to_string(k + 1), cohort.X.colptr(k), cohort.X.n_rows));
+  write_store(filename, sections);
+}
+
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+// TimeWindows.h: biosensors.usc glue
+//
+// Copyright (C) 2019 - 2021  Juan C. Vidal and Marcos Matabuena
+//
+// This file is part of biosensors.usc.
+//
+// biosensors.usc is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// biosensors.usc is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with biosensors.usc.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _TIME_WINDOWS_H // include guard
+#define _TIME_WINDOWS_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "QuantileEstimation.h"
+
+
+namespace bio {
+
+const double SECONDS_PER_DAY = 86400;
+
+/**
+ * Quantile functions of a set of (subject, window) pairs, ordered by subject and window start.
+ */
+struct window_struct {
+  arma::uvec subject;    // 0-based subject of each window
+  arma::vec start;       // start of each window, in seconds since 1970-01-01 00:00:00 UTC
+  arma::uvec count;      // number of readings in each window
+  arma::mat quantiles;   // one row per window
+};
+
+/**
+ * Windows of a single subject, collected before they are assembled in subject order.
+ */
+struct window_rows {
+  std::vector<double> start;
+  std::vector<arma::uword> count;
+  std::vector<double> quantiles;   // row-major, m values per window
+};
+
+/**
+ * Readings bucketed by subject and sorted by time within each subject. Readings with a missing
+ * time or value are discarded.
+ */
+inline void group_by_time(const arma::uvec& id, const arma::vec& time, const arma::vec& value, const arma::uword groups,
+                          arma::uvec& offsets, std::vector<std::pair<double, double> >& readings) {
+  if (id.n_elem != value.n_elem || time.n_elem != value.n_elem)
+    throw std::invalid_argument("Arguments 'id', 'time' and 'value' must have the same length");
+
+  offsets.zeros(groups + 1);
+  for (arma::uword i=0; i < id.n_elem; i++) {
+    if (id(i) >= groups)
+      throw std::invalid_argument("Subject index out of range");
+    if (!std::isnan(value(i)) && !std::isnan(time(i)))
+      offsets(id(i) + 1)++;
+  }
+  for (arma::uword g=0; g < groups; g++)
+    offsets(g + 1) += offsets(g);
+
+  std::vector<arma::uword> next(offsets.memptr(), offsets.memptr() + groups);
+  readings.resize(offsets(groups));
+  for (arma::uword i=0; i < id.n_elem; i++) {
+    if (!std::isnan(value(i)) && !std::isnan(time(i)))
+      readings[next[id(i)]++] = std::make_pair(time(i), value(i));
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++)
+    std::stable_sort(readings.begin() + offsets(g), readings.begin() + offsets(g + 1));
+}
+
+/**
+ * Concatenates the windows of every subject in subject order.
+ */
+inline window_struct assemble_windows(const std::vector<window_rows>& rows, const arma::uword m) {
+  arma::uword groups = rows.size();
+  std::vector<arma::uword> offset(groups + 1, 0);
+  for (arma::uword g=0; g < groups; g++)
+    offset[g + 1] = offset[g] + rows[g].start.size();
+
+  arma::uword n = offset[groups];
+  window_struct result;
+  result.subject.set_size(n);
+  result.start.set_size(n);
+  result.count.set_size(n);
+  result.quantiles.set_size(n, m);
+
+  #pragma omp parallel for schedule(static)
+  for (int g=0; g < (int) groups; g++) {
+    for (arma::uword w=0; w < rows[g].start.size(); w++) {
+      arma::uword r = offset[g] + w;
+      result.subject(r) = g;
+      result.start(r) = rows[g].start[w];
+      result.count(r) = rows[g].count[w];
+      for (arma::uword j=0; j < m; j++)
+        result.quantiles(r, j) = rows[g].quantiles[w * m + j];
+    }
+  }
+  return result;
+}
+
+inline void push_window(window_rows& rows, const double start, const double* x, const arma::uword n,
+                        const arma::vec& t) {
+  arma::uword m = t.n_elem;
+  rows.start.push_back(start);
+  rows.count.push_back(n);
+  rows.quantiles.resize(rows.quantiles.size() + m);
+  sorted_quantiles(x, n, t, &rows.quantiles[rows.quantiles.size() - m], 1);
+}
+
+
+/**
+ * This function computes the quantile function of the readings of each subject in each calendar
+ * window, the daily period [from, to) of the time of day. Windows that cross midnight (from > to)
+ * start on the day of from; from == to selects whole days. Times of day are taken from the
+ * timestamps as they were parsed (UTC), so they match the clock of the csv file.
+ * Inputs:
+ *   id        - 0-based subject index of each reading
+ *   time      - seconds since 1970-01-01 00:00:00 UTC of each reading
+ *   value     - the readings
+ *   groups    - number of subjects
+ *   t         - 1xm vector of probabilities
+ *   from, to  - bounds of the daily period, in hours
+ *   min_count - windows with fewer readings are dropped
+ * Outputs:
+ *   The subject, start and count of each window and its quantiles on the grid t.
+ */
+inline window_struct calendar_window_quantiles(const arma::uvec& id, const arma::vec& time, const arma::vec& value,
+                                               const arma::uword groups, const arma::vec& t, const double from,
+                                               const double to, const arma::uword min_count) {
+  if (!(from >= 0 && from <= 24 && to >= 0 && to <= 24))
+    throw std::invalid_argument("The bounds of the calendar windows must be hours between 0 and 24");
+  double begin = from * 3600;
+  double length = std::fmod(to - from + 24, 24) * 3600;
+  if (length == 0)
+    length = SECONDS_PER_DAY;
+
+  arma::uvec offsets;
+  std::vector<std::pair<double, double> > readings;
+  group_by_time(id, time, value, groups, offsets, readings);
+  std::vector<window_rows> rows(groups);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++) {
+    std::vector<double> x;
+    double current = std::numeric_limits<double>::quiet_NaN();
+    for (arma::uword i=offsets(g); i <= offsets(g + 1); i++) {
+      double day = std::numeric_limits<double>::quiet_NaN();
+      if (i < offsets(g + 1)) {
+        double s = readings[i].first - begin;
+        day = std::floor(s / SECONDS_PER_DAY);
+        if (s - day * SECONDS_PER_DAY >= length)
+          continue;
+      }
+      // readings are sorted by time, so each window is a run of consecutive readings
+      if (day != current) {
+        if (x.size() >= std::max(min_count, (arma::uword) 1)) {
+          std::sort(x.begin(), x.end());
+          push_window(rows[g], current * SECONDS_PER_DAY + begin, x.data(), x.size(), t);
+        }
+        x.clear();
+        current = day;
+      }
+      if (i < offsets(g + 1))
+        x.push_back(readings[i].second);
+    }
+  }
+  return assemble_windows(rows, t.n_elem);
+}
+
+
+/**
+ * This function computes the quantile function of the readings of each subject in sliding
+ * windows [k*step, k*step + width), aligned to 1970-01-01 00:00:00 UTC so that the windows of
+ * all subjects coincide. The readings of the current window are kept sorted and updated as the
+ * window slides: readings that leave are removed and readings that enter are inserted, so each
+ * reading is inserted and removed once instead of recomputing every window from scratch.
+ * Inputs:
+ *   id          - 0-based subject index of each reading
+ *   time        - seconds since 1970-01-01 00:00:00 UTC of each reading
+ *   value       - the readings
+ *   groups      - number of subjects
+ *   t           - 1xm vector of probabilities
+ *   width, step - width of the windows and distance between consecutive starts, in seconds
+ *   min_count   - windows with fewer readings are dropped
+ * Outputs:
+ *   The subject, start and count of each window and its quantiles on the grid t.
+ */
+inline window_struct sliding_window_quantiles(const arma::uvec& id, const arma::vec& time, const arma::vec& value,
+                                              const arma::uword groups, const arma::vec& t, const double width,
+                                              const double step, const arma::uword min_count) {
+  if (!(width > 0) || !(step > 0))
+    throw std::invalid_argument("The width and step of the sliding windows must be positive");
+
+  arma::uvec offsets;
+  std::vector<std::pair<double, double> > readings;
+  group_by_time(id, time, value, groups, offsets, readings);
+  std::vector<window_rows> rows(groups);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g=0; g < (int) groups; g++) {
+    arma::uword first = offsets(g), last = offsets(g + 1);
+    if (first == last)
+      continue;
+    std::vector<double> x;
+    arma::uword lo = first, hi = first;
+    // first window that contains the earliest reading
+    int64_t k = (int64_t) std::floor((readings[first].first - width) / step) + 1;
+    while (lo < last) {
+      double start = k * step;
+      double end = start + width;
+      while (lo < hi && readings[lo].first < start) {
+        x.erase(std::lower_bound(x.begin(), x.end(), readings[lo].second));
+        lo++;
+      }
+      while (hi < last && readings[hi].first < end) {
+        if (readings[hi].first >= start)
+          x.insert(std::upper_bound(x.begin(), x.end(), readings[hi].second), readings[hi].second);
+        else
+          lo++;
+        hi++;
+      }
+      if (x.empty()) {
+        if (lo == last)
+          break;
+        // skip the empty windows of a gap
+        k = std::max(k + 1, (int64_t) std::floor((readings[lo].first - width) / step) + 1);
+        continue;
+      }
+      if (x.size() >= std::max(min_count, (arma::uword) 1))
+        push_window(rows[g], start, x.data(), x.size(), t);
+      k++;
+    }
+  }
+  return assemble_windows(rows, t.n_elem);
+}
+
+
+}
+
+#endif
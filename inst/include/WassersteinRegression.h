@@ -25,8 +25,19 @@
 #endif
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 #include <RcppArmadillo.h>
+#include "ProjectionSolver.h"
+#include "QuantileGrid.h"
 
 #include <time.h>
 
@@ -46,108 +57,96 @@ struct regression_struct {
 };
 
 /**
- * Cumulative numerical integration of points Y using the trapezoidal method.
- * Inputs:
- *   X - matrix of coordinates or scalar spacing
- *   Y - matrix of points
- * Outputs:
- *   C - matrix with the approximate cumulative integral of Y with respect to the scalar spacing specified by X.
+ * Two rows are taken as equal when all their elements differ by at most this.
  */
-inline arma::mat cumtrapz(arma::mat X, arma::mat Y) {
-  if (X.n_rows != Y.n_rows || X.n_cols != Y.n_cols)
-    throw std::invalid_argument("Arguments 'x' and 'y' must be matrices of the same dimension");
-
-  bool transposed = false;
-  if (X.n_rows == 1) {
-    // row vector
-    X = X.t();
-    Y = Y.t();
-    transposed = true;
-  }
-
-  arma::uword n = X.n_rows;
-  arma::uword m = X.n_cols;
-  arma::mat C = arma::zeros(n,m);
-  arma::mat tmp = (X.rows(1,n-1) - X.rows(0,n-2)) % (Y.rows(1,n-1) + Y.rows(0,n-2));
-
-  if (tmp.n_rows == 1)
-    C.row(1) = 0.5 * tmp;
-  else
-    C.rows(1,n-1) = 0.5 * cumsum(tmp);
+const double UNIQUE_TOLERANCE = 0.002;
 
-  if (transposed)
-    return C.t();
-  else
-    return C;
-}
-
-inline bool is_smaller(arma::mat A, arma::uword i, arma::uword j) {
+inline bool rows_close(const arma::mat& A, const arma::uword i, const arma::uword j) {
   for (arma::uword k=0; k < A.n_cols; k++) {
-    if (A(i,k) > A(j,k))
-      return true;
-    else if (A(i,k) < A(j,k))
+    if (!(std::fabs(A(i,k) - A(j,k)) <= UNIQUE_TOLERANCE))
       return false;
   }
-  return false;
+  return true;
 }
 
-inline arma::uword find_index(arma::mat C, arma::rowvec rowA) {
-  for (arma::uword i=0; i < C.n_rows; i++) {
-    arma::rowvec rowC = C.row(i);
-    if (arma::approx_equal(rowA, rowC, "absdiff", 0.002))
-      return i;
-  }
-  return 0;
+/**
+ * Cell of the first element of a row. Rows closer than UNIQUE_TOLERANCE lie in the same or in
+ * adjacent cells. Rows whose first element is missing or out of range are never merged.
+ */
+inline int64_t unique_cell(const double x) {
+  double cell = std::floor(x / UNIQUE_TOLERANCE);
+  return std::fabs(cell) < 1e18 ? (int64_t) cell : std::numeric_limits<int64_t>::min();
 }
 
 
 /**
  * This is an auxiliary function that returns a tuple with a matrix M containing the
- * unique rows of A and a vector of indices ic such that A = M(ic).
+ * unique rows of A and a vector of indices ic such that A = M(ic). Rows are scanned in order and
+ * a row is unique when no unique row found before is within UNIQUE_TOLERANCE of it. The unique
+ * rows are sorted lexicographically, and each row of A is mapped to the first unique row within
+ * tolerance. Unique rows are bucketed by the cell of their first element, so each row is only
+ * compared with the unique rows of three cells and the cost is O(r log r) for r rows unless many
+ * rows share their first element.
  * Inputs:
  *   A - a matrix
  * Outputs:
  *   B  - a matrix with the unique rows
  *   ic - vector of indices
  */
-inline std::tuple<arma::mat, arma::uvec> ic_unique_rows(arma::mat A) {
-  arma::mat B(A.n_rows, A.n_cols);
-  arma::uword count = 0;
-  for (arma::uword i=0; i < A.n_rows; i++) {
-    arma::rowvec rowA = A.row(i);
+inline std::tuple<arma::mat, arma::uvec> ic_unique_rows(const arma::mat& A) {
+  arma::uword r = A.n_rows, p = A.n_cols;
+  std::unordered_map<int64_t, std::vector<arma::uword> > cells;
+  std::vector<arma::uword> unique;
+  for (arma::uword i=0; i < r; i++) {
+    int64_t cell = unique_cell(A(i,0));
     bool found = false;
-    for (arma::uword j=0; j < count; j++) {
-      arma::rowvec rowB = B.row(j);
-      if (arma::approx_equal(rowA, rowB, "absdiff", 0.002)) {
-        found = true;
-        break;
-      }
+    for (int64_t c = cell - 1; c <= cell + 1 && !found && cell != std::numeric_limits<int64_t>::min(); c++) {
+      std::unordered_map<int64_t, std::vector<arma::uword> >::const_iterator it = cells.find(c);
+      if (it == cells.end())
+        continue;
+      for (size_t u=0; u < it->second.size() && !found; u++)
+        found = rows_close(A, i, it->second[u]);
+    }
+    if (!found) {
+      cells[cell].push_back(i);
+      unique.push_back(i);
     }
-    if (!found)
-      B.row(count++) = rowA;
   }
 
-  B = B.rows(0, count-1);
-  arma::uvec indices = sort_index(B.col(0));
-  for (arma::uword i=0; i < indices.n_elem-1; i++) {
-    for (arma::uword j=i+1; j < indices.n_elem; j++) {
-      if (B(indices(i),0) < B(indices(j),0))
-        break;
-      if (is_smaller(B,indices(i),indices(j))) {
-        arma::uword aux = indices(i);
-        indices(i) = indices(j);
-        indices(j) = aux;
-      }
+  std::vector<arma::uword> order(unique);
+  std::stable_sort(order.begin(), order.end(), [&A, p](const arma::uword a, const arma::uword b) {
+    for (arma::uword k=0; k < p; k++) {
+      if (A(a,k) != A(b,k))
+        return A(a,k) < A(b,k);
     }
+    return false;
+  });
+  std::vector<arma::uword> rank(r);
+  arma::mat C(order.size(), p);
+  for (arma::uword u=0; u < order.size(); u++) {
+    rank[order[u]] = u;
+    for (arma::uword k=0; k < p; k++)
+      C(u,k) = A(order[u],k);
   }
-  arma::mat C = arma::mat(B.n_rows, B.n_cols, arma::fill::zeros);
-  for (arma::uword i=0; i < B.n_rows; i++)
-    C.row(i) = B.row(indices(i));
-
-  arma::uvec ic(A.n_rows);
-  for (arma::uword i=0; i < A.n_rows; i++) {
-    arma::rowvec rowA = A.row(i);
-    ic(i) = find_index(C, rowA);
+
+  arma::uvec ic(r);
+  #pragma omp parallel for schedule(static)
+  for (int i=0; i < (int) r; i++) {
+    int64_t cell = unique_cell(A(i,0));
+    arma::uword best = std::numeric_limits<arma::uword>::max();
+    if (cell == std::numeric_limits<int64_t>::min())
+      best = rank[i];
+    for (int64_t c = cell - 1; c <= cell + 1 && cell != std::numeric_limits<int64_t>::min(); c++) {
+      std::unordered_map<int64_t, std::vector<arma::uword> >::const_iterator it = cells.find(c);
+      if (it == cells.end())
+        continue;
+      for (size_t u=0; u < it->second.size(); u++) {
+        arma::uword j = it->second[u];
+        if (rows_close(A, i, j))
+          best = std::min(best, rank[j]);
+      }
+    }
+    ic(i) = best;
   }
 
   return std::make_tuple(C, ic);
@@ -156,45 +155,99 @@ inline std::tuple<arma::mat, arma::uvec> ic_unique_rows(arma::mat A) {
 
 /**
  * This is an auxiliary function that computes the matrix C and vector c for the quadratic program.
+ * The grid may be non-uniform (see quantile_grid); integrals use its trapezoid weights w. With the
+ * spacings d, K = m-2 and a(k) = (d(k) + d(k+1)) / 2, the entries are c(i) = w(i) (d(K)/2 + S(i))
+ * and C(i,j) = w(i) w(j) (d(K)/10 + S(max(i,j))), where S(l) is the sum of a(k) for
+ * k = max(0, l-1), ..., K-1 (see qp_suffix_sums), so both are built in O(m^2).
  * Inputs:
  *   t - grid vector on [0,1]
  * Outputs:
  *   c - vector for the quadratic program
  *   C - matrix for the quadratic program
  */
-inline std::tuple<arma::vec, arma::mat> getcC(arma::vec t) {
-  arma::vec deltaT = arma::diff(t);
-  arma::vec deltaTp = arma::join_vert(deltaT, arma::zeros(1));
-  arma::vec deltaTm = arma::join_vert(arma::zeros(1), deltaT);
-
-  arma::vec bm = 0.5 * (deltaTp + deltaTm);
-  arma::mat Dm = bm * bm.t();
-
-  arma::uword m = deltaT.n_elem-1;
-  arma::vec c = 0.5 * deltaT(m) * bm;
-  arma::mat C = 0.1 * deltaT(m) * Dm;
-
-  for (arma::uword k = 0; k < m; k++) {
-    arma::vec bk = 0.5 * arma::join_vert(deltaTm.rows(0, k+1) + deltaTp.rows(0, k+1), arma::zeros(m-k, 1));
-    c = c + 0.5 * (deltaT(k) + deltaT(k+1)) * bk;
-    arma::mat Dk = bk * bk.t();
-    C = C + 0.5 * (deltaT(k) + deltaT(k+1)) * Dk;
+inline std::tuple<arma::vec, arma::mat> getcC(const arma::vec& t) {
+  arma::uword m = t.n_elem;
+  if (m < 3)
+    throw std::invalid_argument("The grid t must have at least three points");
+  arma::vec w = trapezoid_weights(t);
+  double dK = t(m - 1) - t(m - 2);
+  arma::vec S = qp_suffix_sums(t);
+
+  arma::vec c(m);
+  arma::mat C(m, m);
+  for (arma::uword j = 0; j < m; j++) {
+    c(j) = w(j) * (0.5 * dK + S(j));
+    for (arma::uword i = 0; i < m; i++)
+      C(i, j) = w(i) * w(j) * (0.1 * dK + S(std::max(i, j)));
   }
-
   return std::make_tuple(c,C);
 }
 
 
+/**
+ * Matrices of the quadratic program that projects a fitted quantile density onto the positive
+ * ones (see wasserstein_regression), which only depend on the grid t.
+ */
+struct qp_matrices {
+  arma::vec t;
+  arma::vec c;
+  arma::mat C;
+  arma::mat D;   // [1 c'; c C]
+};
+
+/**
+ * This function returns the matrices of the quadratic program for the grid t. They are cached
+ * for the last few grids used in the process, so repeated fits on the same grid (folds,
+ * bootstrap replicates, confidence bands) build them only once. The cache is thread-safe.
+ */
+inline std::shared_ptr<const qp_matrices> cached_qp_matrices(const arma::vec& t) {
+  static std::mutex lock;
+  static std::list<std::shared_ptr<const qp_matrices> > cache;
+  const size_t capacity = 8;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for (std::list<std::shared_ptr<const qp_matrices> >::iterator it = cache.begin(); it != cache.end(); ++it) {
+      const arma::vec& key = (*it)->t;
+      if (key.n_elem == t.n_elem && std::equal(key.memptr(), key.memptr() + key.n_elem, t.memptr())) {
+        cache.splice(cache.begin(), cache, it);
+        return cache.front();
+      }
+    }
+  }
+
+  std::shared_ptr<qp_matrices> qp = std::make_shared<qp_matrices>();
+  qp->t = t;
+  std::tie(qp->c, qp->C) = getcC(t);
+  arma::uword m = t.n_elem;
+  qp->D.set_size(m + 1, m + 1);
+  qp->D(0, 0) = 1;
+  for (arma::uword i = 0; i < m; i++) {
+    qp->D(0, i + 1) = qp->c(i);
+    qp->D(i + 1, 0) = qp->c(i);
+    for (arma::uword j = 0; j < m; j++)
+      qp->D(i + 1, j + 1) = qp->C(i, j);
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  cache.push_front(qp);
+  if (cache.size() > capacity)
+    cache.pop_back();
+  return qp;
+}
+
+
 
 /**
  * This function perform Frechet regression with the Wasserstein distance
  * Inputs:
  *   xfit - nxp matrix of predictor values for fitting (do not include a column for the intercept)
- *   q - nxm matrix of quantile density functions. q(i, :) is a 1xm vector of quantile density function values on an equispaced grid on [0, 1]
+ *   q - nxm matrix of quantile density functions. q(i, :) is a 1xm vector of quantile density function values on the grid t
  *	 Q0 - 1xn array of quantile function values at 0
  *   xpred - kxp matrix of input values for regressors for prediction.
- *   t - 1xm vector - common grid for all quantile density functions in q.  If missing, defaults to linspace(0, 1, m);  For best results, should use a finer grid than for quantle estimation, especially near the boundaries
+ *   t - 1xm vector - common grid for all quantile density functions in q.  If missing, defaults to linspace(0, 1, m);  For best results, should use a finer grid than for quantle estimation, especially near the boundaries (see quantile_grid)
  *   qdmin - a positive lower bound on the estimated quantile densites.  Defaults to 1e-6.
+ *   solver - QP_ALGLIB or QP_ADMM (see qp_backend); a row that QP_ADMM does not solve falls back to QP_ALGLIB
  * Outputs:
  *   A structure with the following fields:
  *	   xpred - see input of same name
@@ -208,7 +261,10 @@ inline std::tuple<arma::vec, arma::mat> getcC(arma::vec t) {
  *	   QP_used - flag indicating whether OLS fits all satisfied the constraints (=0) or if the quadratic program was used in fitting (=1)
  */
 inline regression_struct wasserstein_regression(const arma::mat xfit, const arma::mat q, const arma::mat Q0,
-                         const arma::mat xpred, const arma::vec t, const double qdmin) {
+                         const arma::mat xpred, const arma::vec t, const double qdmin,
+                         const int solver = QP_ALGLIB) {
+  if (solver != QP_ALGLIB && solver != QP_ADMM)
+    throw std::invalid_argument("Unknown quadratic program solver");
   arma::uword n = q.n_rows;
   arma::uword m = q.n_cols;
 
@@ -241,18 +297,30 @@ inline regression_struct wasserstein_regression(const arma::mat xfit, const arma
   if (!dec.is_empty()) {
     QP_used = 1; // Set to 1 if quadratic program was used
 
-    arma::vec c;
-    arma::mat C;
-    std::tie(c,C) = getcC(t);
+    std::shared_ptr<const qp_matrices> qp = cached_qp_matrices(t);
+    const arma::vec& c = qp->c;
+    const arma::mat& C = qp->C;
 
-    arma::mat D = arma::join_vert(arma::join_vert(arma::ones(1,1), c).t(), arma::join_horiz(c, C));
-    arma::mat V1 = arma::join_horiz(arma::zeros(m,1), - arma::eye(m,m));
-    arma::mat Qdmin = {qdmin};
-    arma::mat v1 = -repmat(Qdmin, 1, m);
+    // The variables are (Q0, q); q >= qdmin is a box bound, and the smoothness penalty bounds
+    // the differences of consecutive q, |q(i+1) - q(i)| <= v2(i), which is the only term of the
+    // program besides d that changes from row to row.
     arma::mat V2 = arma::join_horiz(arma::zeros(m-1, 1),
                                     arma::join_horiz(arma::eye(m-1, m-1),
                                                      arma::zeros(m-1, 1)) - arma::join_horiz(arma::zeros(m-1, 1),
                                                      arma::eye(m-1, m-1)));
+    arma::vec lb(m+1), ub(m+1);
+    lb.fill(qdmin);
+    lb(0) = -std::numeric_limits<double>::infinity();
+    ub.fill(std::numeric_limits<double>::infinity());
+    qp_projection projection(qp->D, V2, lb, ub);
+    std::unique_ptr<admm_projection> admm;
+    if (solver == QP_ADMM) {
+      try {
+        admm.reset(new admm_projection(t, qdmin));
+      } catch (const std::exception&) {
+        // grids with repeated points, or on which the program is far from convex, are left to alglib
+      }
+    }
 
     #pragma omp parallel for
     for (arma::uword j=0; j < dec.n_elem; j++) {
@@ -261,13 +329,22 @@ inline regression_struct wasserstein_regression(const arma::mat xfit, const arma
       arma::vec d = - arma::join_vert(ax + c.t()*hx.t(), ax*c + C*hx.t());
       // This penalty induces smoothness into the quantile density estimates.
       // The multiplier of 1.5 is arbitrary, and should probably be chosen more carefully.
-      arma::rowvec v2 = 1.5*abs(arma::diff(hx));
-      arma::mat V = arma::join_vert(V1, arma::join_vert(V2, -V2));
-      arma::rowvec v = arma::join_horiz(v1, arma::join_horiz(v2, v2));
+      arma::vec v2 = 1.5*abs(arma::diff(hx)).t();
 
       arma::vec tmp(d.n_elem, arma::fill::zeros);
       try {
-        tmp = quadprog(D, d, V, v.t());
+        bool solved = false;
+        if (admm) {
+          try {
+            // the unconstrained minimum is the fit itself
+            tmp = admm->solve(d, v2, arma::join_vert(arma::vec({ax}), hx.t()));
+            solved = true;
+          } catch (const std::runtime_error&) {
+            // not converged; the row is solved by alglib
+          }
+        }
+        if (!solved)
+          tmp = projection.solve(d, -v2, v2);
       } catch (...) {
         std::cout << "WARNING: An error has occurred during the quadratic optimization..." << std::endl;
       }
@@ -277,13 +354,7 @@ inline regression_struct wasserstein_regression(const arma::mat xfit, const arma
   }
 
   // Get quantile functions by numerical integration, then densities by inverse of quantile density
-  arma::mat Qall;
-  for (arma::uword j=0; j < r; j++) {
-    if (j == 181 || j == 19) {
-      arma::mat ct = cumtrapz(t.t(), qall.row(j));
-    }
-    Qall = arma::join_vert(Qall, Q0all(j) + cumtrapz(t.t(), qall.row(j)));
-  }
+  arma::mat Qall = cumulative_trapezoid(t, qall, Q0all);
 
   arma::mat fall = 1 / qall;
   arma::mat Qfit  = Qall.rows(ic.subvec(k,k+n-1));
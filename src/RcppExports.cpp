@@ -7,8 +7,8 @@
 using namespace Rcpp;
 
 // cpp_wasserstein_regression
-Rcpp::List cpp_wasserstein_regression(const arma::mat xfit, const arma::mat q, const arma::mat Q0, const arma::mat xpred, const arma::vec t, const double qdmin);
-RcppExport SEXP _biosensors_usc_cpp_wasserstein_regression(SEXP xfitSEXP, SEXP qSEXP, SEXP Q0SEXP, SEXP xpredSEXP, SEXP tSEXP, SEXP qdminSEXP) {
+Rcpp::List cpp_wasserstein_regression(const arma::mat xfit, const arma::mat q, const arma::mat Q0, const arma::mat xpred, const arma::vec t, const double qdmin, const int solver);
+RcppExport SEXP _biosensors_usc_cpp_wasserstein_regression(SEXP xfitSEXP, SEXP qSEXP, SEXP Q0SEXP, SEXP xpredSEXP, SEXP tSEXP, SEXP qdminSEXP, SEXP solverSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -18,7 +18,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const arma::mat >::type xpred(xpredSEXP);
     Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
     Rcpp::traits::input_parameter< const double >::type qdmin(qdminSEXP);
-    rcpp_result_gen = Rcpp::wrap(cpp_wasserstein_regression(xfit, q, Q0, xpred, t, qdmin));
+    Rcpp::traits::input_parameter< const int >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_wasserstein_regression(xfit, q, Q0, xpred, t, qdmin, solver));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -86,13 +87,517 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// cpp_read_csv
+Rcpp::List cpp_read_csv(const std::string filename, const int threads, const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes, const double min, const double max);
+RcppExport SEXP _biosensors_usc_cpp_read_csv(SEXP filenameSEXP, SEXP threadsSEXP, SEXP sentinelsSEXP, SEXP substitutesSEXP, SEXP minSEXP, SEXP maxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< const int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::CharacterVector >::type sentinels(sentinelsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type substitutes(substitutesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min(minSEXP);
+    Rcpp::traits::input_parameter< const double >::type max(maxSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_read_csv(filename, threads, sentinels, substitutes, min, max));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_read_csv_files
+Rcpp::List cpp_read_csv_files(const std::vector<std::string> filenames, const int threads, const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes, const double min, const double max);
+RcppExport SEXP _biosensors_usc_cpp_read_csv_files(SEXP filenamesSEXP, SEXP threadsSEXP, SEXP sentinelsSEXP, SEXP substitutesSEXP, SEXP minSEXP, SEXP maxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type filenames(filenamesSEXP);
+    Rcpp::traits::input_parameter< const int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::CharacterVector >::type sentinels(sentinelsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type substitutes(substitutesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min(minSEXP);
+    Rcpp::traits::input_parameter< const double >::type max(maxSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_read_csv_files(filenames, threads, sentinels, substitutes, min, max));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_quantile_matrix
+arma::mat cpp_quantile_matrix(const arma::uvec id, const arma::vec value, const int groups, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_quantile_matrix(SEXP idSEXP, SEXP valueSEXP, SEXP groupsSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< const int >::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_quantile_matrix(id, value, groups, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_density_matrix
+arma::mat cpp_density_matrix(const arma::uvec id, const arma::vec value, const int groups, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_density_matrix(SEXP idSEXP, SEXP valueSEXP, SEXP groupsSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< const int >::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_density_matrix(id, value, groups, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_sketch_create
+SEXP cpp_sketch_create(const int k);
+RcppExport SEXP _biosensors_usc_cpp_sketch_create(SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_sketch_create(k));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_sketch_update
+void cpp_sketch_update(SEXP sketch, const std::vector<std::string> ids, const arma::uvec id, const arma::vec value);
+RcppExport SEXP _biosensors_usc_cpp_sketch_update(SEXP sketchSEXP, SEXP idsSEXP, SEXP idSEXP, SEXP valueSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type ids(idsSEXP);
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    cpp_sketch_update(sketch, ids, id, value);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_sketch_update_file
+void cpp_sketch_update_file(SEXP sketch, const std::string filename, const int threads);
+RcppExport SEXP _biosensors_usc_cpp_sketch_update_file(SEXP sketchSEXP, SEXP filenameSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< const int >::type threads(threadsSEXP);
+    cpp_sketch_update_file(sketch, filename, threads);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_sketch_merge
+void cpp_sketch_merge(SEXP sketch, SEXP other);
+RcppExport SEXP _biosensors_usc_cpp_sketch_merge(SEXP sketchSEXP, SEXP otherSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type other(otherSEXP);
+    cpp_sketch_merge(sketch, other);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_sketch_quantiles
+Rcpp::List cpp_sketch_quantiles(SEXP sketch, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_sketch_quantiles(SEXP sketchSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_sketch_quantiles(sketch, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_store_write
+void cpp_store_write(const std::string filename, const Rcpp::List sections);
+RcppExport SEXP _biosensors_usc_cpp_store_write(SEXP filenameSEXP, SEXP sectionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List >::type sections(sectionsSEXP);
+    cpp_store_write(filename, sections);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_store_read
+Rcpp::List cpp_store_read(const std::string filename);
+RcppExport SEXP _biosensors_usc_cpp_store_read(SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type filename(filenameSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_store_read(filename));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_sketch_densities
+arma::mat cpp_sketch_densities(SEXP sketch, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_sketch_densities(SEXP sketchSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_sketch_densities(sketch, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_sketch_serialize
+Rcpp::RawVector cpp_sketch_serialize(SEXP sketch);
+RcppExport SEXP _biosensors_usc_cpp_sketch_serialize(SEXP sketchSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_sketch_serialize(sketch));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_sketch_unserialize
+SEXP cpp_sketch_unserialize(const Rcpp::RawVector bytes);
+RcppExport SEXP _biosensors_usc_cpp_sketch_unserialize(SEXP bytesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::RawVector >::type bytes(bytesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_sketch_unserialize(bytes));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_stream_csv
+Rcpp::List cpp_stream_csv(SEXP sketch, const std::string filename, const double chunk_bytes, const int threads, const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes, const double min, const double max);
+RcppExport SEXP _biosensors_usc_cpp_stream_csv(SEXP sketchSEXP, SEXP filenameSEXP, SEXP chunk_bytesSEXP, SEXP threadsSEXP, SEXP sentinelsSEXP, SEXP substitutesSEXP, SEXP minSEXP, SEXP maxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< const double >::type chunk_bytes(chunk_bytesSEXP);
+    Rcpp::traits::input_parameter< const int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::CharacterVector >::type sentinels(sentinelsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type substitutes(substitutesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min(minSEXP);
+    Rcpp::traits::input_parameter< const double >::type max(maxSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_stream_csv(sketch, filename, chunk_bytes, threads, sentinels, substitutes, min, max));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_join_ids
+Rcpp::List cpp_join_ids(const std::vector<std::string> keys, const std::vector<std::string> ids);
+RcppExport SEXP _biosensors_usc_cpp_join_ids(SEXP keysSEXP, SEXP idsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type keys(keysSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type ids(idsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_join_ids(keys, ids));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_window_quantiles
+Rcpp::List cpp_window_quantiles(const arma::uvec id, const arma::vec time, const arma::vec value, const int groups, const arma::vec t, const double from, const double to, const double width, const double step, const int min_count);
+RcppExport SEXP _biosensors_usc_cpp_window_quantiles(SEXP idSEXP, SEXP timeSEXP, SEXP valueSEXP, SEXP groupsSEXP, SEXP tSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP widthSEXP, SEXP stepSEXP, SEXP min_countSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< const int >::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    Rcpp::traits::input_parameter< const double >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< const double >::type to(toSEXP);
+    Rcpp::traits::input_parameter< const double >::type width(widthSEXP);
+    Rcpp::traits::input_parameter< const double >::type step(stepSEXP);
+    Rcpp::traits::input_parameter< const int >::type min_count(min_countSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_window_quantiles(id, time, value, groups, t, from, to, width, step, min_count));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_quantile_grid
+arma::vec cpp_quantile_grid(const arma::uvec id, const arma::vec value, const int groups, const double tol, const int min_points, const int max_points, const int resolution);
+RcppExport SEXP _biosensors_usc_cpp_quantile_grid(SEXP idSEXP, SEXP valueSEXP, SEXP groupsSEXP, SEXP tolSEXP, SEXP min_pointsSEXP, SEXP max_pointsSEXP, SEXP resolutionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< const int >::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type min_points(min_pointsSEXP);
+    Rcpp::traits::input_parameter< const int >::type max_points(max_pointsSEXP);
+    Rcpp::traits::input_parameter< const int >::type resolution(resolutionSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_quantile_grid(id, value, groups, tol, min_points, max_points, resolution));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_sketch_grid
+arma::vec cpp_sketch_grid(SEXP sketch, const double tol, const int min_points, const int max_points, const int resolution);
+RcppExport SEXP _biosensors_usc_cpp_sketch_grid(SEXP sketchSEXP, SEXP tolSEXP, SEXP min_pointsSEXP, SEXP max_pointsSEXP, SEXP resolutionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type min_points(min_pointsSEXP);
+    Rcpp::traits::input_parameter< const int >::type max_points(max_pointsSEXP);
+    Rcpp::traits::input_parameter< const int >::type resolution(resolutionSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_sketch_grid(sketch, tol, min_points, max_points, resolution));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_encode_quantiles
+Rcpp::List cpp_encode_quantiles(const arma::mat Q, const int precision, const int block);
+RcppExport SEXP _biosensors_usc_cpp_encode_quantiles(SEXP QSEXP, SEXP precisionSEXP, SEXP blockSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::mat >::type Q(QSEXP);
+    Rcpp::traits::input_parameter< const int >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< const int >::type block(blockSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_encode_quantiles(Q, precision, block));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_decode_quantiles
+arma::mat cpp_decode_quantiles(const Rcpp::List x, const arma::uvec rows);
+RcppExport SEXP _biosensors_usc_cpp_decode_quantiles(SEXP xSEXP, SEXP rowsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const arma::uvec >::type rows(rowsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_decode_quantiles(x, rows));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_codec_distances
+arma::mat cpp_codec_distances(const Rcpp::List x, const Rcpp::List y, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_codec_distances(SEXP xSEXP, SEXP ySEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List >::type y(ySEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_codec_distances(x, y, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_ingest_files
+Rcpp::List cpp_ingest_files(SEXP sketch, const std::vector<std::string> filenames, const std::string logname, const double chunk_bytes, const int threads, const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes, const double min, const double max, const arma::vec t, const double tol, const int min_points, const int max_points, const int resolution);
+RcppExport SEXP _biosensors_usc_cpp_ingest_files(SEXP sketchSEXP, SEXP filenamesSEXP, SEXP lognameSEXP, SEXP chunk_bytesSEXP, SEXP threadsSEXP, SEXP sentinelsSEXP, SEXP substitutesSEXP, SEXP minSEXP, SEXP maxSEXP, SEXP tSEXP, SEXP tolSEXP, SEXP min_pointsSEXP, SEXP max_pointsSEXP, SEXP resolutionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type filenames(filenamesSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type logname(lognameSEXP);
+    Rcpp::traits::input_parameter< const double >::type chunk_bytes(chunk_bytesSEXP);
+    Rcpp::traits::input_parameter< const int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::CharacterVector >::type sentinels(sentinelsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type substitutes(substitutesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min(minSEXP);
+    Rcpp::traits::input_parameter< const double >::type max(maxSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type min_points(min_pointsSEXP);
+    Rcpp::traits::input_parameter< const int >::type max_points(max_pointsSEXP);
+    Rcpp::traits::input_parameter< const int >::type resolution(resolutionSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_ingest_files(sketch, filenames, logname, chunk_bytes, threads, sentinels, substitutes, min, max, t, tol, min_points, max_points, resolution));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_resample
+Rcpp::List cpp_resample(const arma::uvec id, const arma::vec time, const arma::vec value, const int groups, const double step, const double max_gap, const int method);
+RcppExport SEXP _biosensors_usc_cpp_resample(SEXP idSEXP, SEXP timeSEXP, SEXP valueSEXP, SEXP groupsSEXP, SEXP stepSEXP, SEXP max_gapSEXP, SEXP methodSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< const int >::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter< const double >::type step(stepSEXP);
+    Rcpp::traits::input_parameter< const double >::type max_gap(max_gapSEXP);
+    Rcpp::traits::input_parameter< const int >::type method(methodSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_resample(id, time, value, groups, step, max_gap, method));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_grid_derivative
+arma::mat cpp_grid_derivative(arma::mat Q, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_grid_derivative(SEXP QSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::mat >::type Q(QSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_grid_derivative(Q, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_quantile_to_density
+arma::mat cpp_quantile_to_density(const arma::mat Q, const arma::mat q, const arma::vec x);
+RcppExport SEXP _biosensors_usc_cpp_quantile_to_density(SEXP QSEXP, SEXP qSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::mat >::type Q(QSEXP);
+    Rcpp::traits::input_parameter< const arma::mat >::type q(qSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_quantile_to_density(Q, q, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_generate_data
+Rcpp::List cpp_generate_data(const int n, const arma::vec Q0, const int Xp, const int scenario, const double seed, const arma::vec t, const std::string filename);
+RcppExport SEXP _biosensors_usc_cpp_generate_data(SEXP nSEXP, SEXP Q0SEXP, SEXP XpSEXP, SEXP scenarioSEXP, SEXP seedSEXP, SEXP tSEXP, SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type Q0(Q0SEXP);
+    Rcpp::traits::input_parameter< const int >::type Xp(XpSEXP);
+    Rcpp::traits::input_parameter< const int >::type scenario(scenarioSEXP);
+    Rcpp::traits::input_parameter< const double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type filename(filenameSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_generate_data(n, Q0, Xp, scenario, seed, t, filename));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_glycemic_metrics
+Rcpp::NumericMatrix cpp_glycemic_metrics(const arma::uvec id, const arma::vec time, const arma::vec value, const int groups);
+RcppExport SEXP _biosensors_usc_cpp_glycemic_metrics(SEXP idSEXP, SEXP timeSEXP, SEXP valueSEXP, SEXP groupsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec >::type id(idSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< const int >::type groups(groupsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_glycemic_metrics(id, time, value, groups));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_histogram_create
+SEXP cpp_histogram_create(const double lo, const double hi, const double width);
+RcppExport SEXP _biosensors_usc_cpp_histogram_create(SEXP loSEXP, SEXP hiSEXP, SEXP widthSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const double >::type lo(loSEXP);
+    Rcpp::traits::input_parameter< const double >::type hi(hiSEXP);
+    Rcpp::traits::input_parameter< const double >::type width(widthSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_histogram_create(lo, hi, width));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_stream_histograms
+Rcpp::List cpp_stream_histograms(SEXP histogram, const std::vector<std::string> filenames, const std::vector<std::string> subjects, const double chunk_bytes, const int threads, const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes, const double min, const double max);
+RcppExport SEXP _biosensors_usc_cpp_stream_histograms(SEXP histogramSEXP, SEXP filenamesSEXP, SEXP subjectsSEXP, SEXP chunk_bytesSEXP, SEXP threadsSEXP, SEXP sentinelsSEXP, SEXP substitutesSEXP, SEXP minSEXP, SEXP maxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type histogram(histogramSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type filenames(filenamesSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string> >::type subjects(subjectsSEXP);
+    Rcpp::traits::input_parameter< const double >::type chunk_bytes(chunk_bytesSEXP);
+    Rcpp::traits::input_parameter< const int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::CharacterVector >::type sentinels(sentinelsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type substitutes(substitutesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min(minSEXP);
+    Rcpp::traits::input_parameter< const double >::type max(maxSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_stream_histograms(histogram, filenames, subjects, chunk_bytes, threads, sentinels, substitutes, min, max));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_histogram_quantiles
+Rcpp::List cpp_histogram_quantiles(SEXP histogram, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_histogram_quantiles(SEXP histogramSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type histogram(histogramSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_histogram_quantiles(histogram, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_histogram_densities
+arma::mat cpp_histogram_densities(SEXP histogram, const arma::vec t);
+RcppExport SEXP _biosensors_usc_cpp_histogram_densities(SEXP histogramSEXP, SEXP tSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type histogram(histogramSEXP);
+    Rcpp::traits::input_parameter< const arma::vec >::type t(tSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_histogram_densities(histogram, t));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_histogram_serialize
+Rcpp::RawVector cpp_histogram_serialize(SEXP histogram);
+RcppExport SEXP _biosensors_usc_cpp_histogram_serialize(SEXP histogramSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type histogram(histogramSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_histogram_serialize(histogram));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_histogram_unserialize
+SEXP cpp_histogram_unserialize(const Rcpp::RawVector bytes);
+RcppExport SEXP _biosensors_usc_cpp_histogram_unserialize(SEXP bytesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::RawVector >::type bytes(bytesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_histogram_unserialize(bytes));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_biosensors_usc_cpp_wasserstein_regression", (DL_FUNC) &_biosensors_usc_cpp_wasserstein_regression, 6},
+    {"_biosensors_usc_cpp_wasserstein_regression", (DL_FUNC) &_biosensors_usc_cpp_wasserstein_regression, 7},
     {"_biosensors_usc_cpp_confidence_band", (DL_FUNC) &_biosensors_usc_cpp_confidence_band, 6},
     {"_biosensors_usc_cpp_nadayara_regression", (DL_FUNC) &_biosensors_usc_cpp_nadayara_regression, 6},
     {"_biosensors_usc_cpp_nadayara_prediction", (DL_FUNC) &_biosensors_usc_cpp_nadayara_prediction, 6},
     {"_biosensors_usc_cpp_ridge_regression", (DL_FUNC) &_biosensors_usc_cpp_ridge_regression, 6},
+    {"_biosensors_usc_cpp_read_csv", (DL_FUNC) &_biosensors_usc_cpp_read_csv, 6},
+    {"_biosensors_usc_cpp_read_csv_files", (DL_FUNC) &_biosensors_usc_cpp_read_csv_files, 6},
+    {"_biosensors_usc_cpp_quantile_matrix", (DL_FUNC) &_biosensors_usc_cpp_quantile_matrix, 4},
+    {"_biosensors_usc_cpp_density_matrix", (DL_FUNC) &_biosensors_usc_cpp_density_matrix, 4},
+    {"_biosensors_usc_cpp_sketch_create", (DL_FUNC) &_biosensors_usc_cpp_sketch_create, 1},
+    {"_biosensors_usc_cpp_sketch_update", (DL_FUNC) &_biosensors_usc_cpp_sketch_update, 4},
+    {"_biosensors_usc_cpp_sketch_update_file", (DL_FUNC) &_biosensors_usc_cpp_sketch_update_file, 3},
+    {"_biosensors_usc_cpp_sketch_merge", (DL_FUNC) &_biosensors_usc_cpp_sketch_merge, 2},
+    {"_biosensors_usc_cpp_sketch_quantiles", (DL_FUNC) &_biosensors_usc_cpp_sketch_quantiles, 2},
+    {"_biosensors_usc_cpp_store_write", (DL_FUNC) &_biosensors_usc_cpp_store_write, 2},
+    {"_biosensors_usc_cpp_store_read", (DL_FUNC) &_biosensors_usc_cpp_store_read, 1},
+    {"_biosensors_usc_cpp_sketch_densities", (DL_FUNC) &_biosensors_usc_cpp_sketch_densities, 2},
+    {"_biosensors_usc_cpp_sketch_serialize", (DL_FUNC) &_biosensors_usc_cpp_sketch_serialize, 1},
+    {"_biosensors_usc_cpp_sketch_unserialize", (DL_FUNC) &_biosensors_usc_cpp_sketch_unserialize, 1},
+    {"_biosensors_usc_cpp_stream_csv", (DL_FUNC) &_biosensors_usc_cpp_stream_csv, 8},
+    {"_biosensors_usc_cpp_join_ids", (DL_FUNC) &_biosensors_usc_cpp_join_ids, 2},
+    {"_biosensors_usc_cpp_window_quantiles", (DL_FUNC) &_biosensors_usc_cpp_window_quantiles, 10},
+    {"_biosensors_usc_cpp_quantile_grid", (DL_FUNC) &_biosensors_usc_cpp_quantile_grid, 7},
+    {"_biosensors_usc_cpp_sketch_grid", (DL_FUNC) &_biosensors_usc_cpp_sketch_grid, 5},
+    {"_biosensors_usc_cpp_encode_quantiles", (DL_FUNC) &_biosensors_usc_cpp_encode_quantiles, 3},
+    {"_biosensors_usc_cpp_decode_quantiles", (DL_FUNC) &_biosensors_usc_cpp_decode_quantiles, 2},
+    {"_biosensors_usc_cpp_codec_distances", (DL_FUNC) &_biosensors_usc_cpp_codec_distances, 3},
+    {"_biosensors_usc_cpp_ingest_files", (DL_FUNC) &_biosensors_usc_cpp_ingest_files, 14},
+    {"_biosensors_usc_cpp_resample", (DL_FUNC) &_biosensors_usc_cpp_resample, 7},
+    {"_biosensors_usc_cpp_grid_derivative", (DL_FUNC) &_biosensors_usc_cpp_grid_derivative, 2},
+    {"_biosensors_usc_cpp_quantile_to_density", (DL_FUNC) &_biosensors_usc_cpp_quantile_to_density, 3},
+    {"_biosensors_usc_cpp_generate_data", (DL_FUNC) &_biosensors_usc_cpp_generate_data, 7},
+    {"_biosensors_usc_cpp_glycemic_metrics", (DL_FUNC) &_biosensors_usc_cpp_glycemic_metrics, 4},
+    {"_biosensors_usc_cpp_histogram_create", (DL_FUNC) &_biosensors_usc_cpp_histogram_create, 3},
+    {"_biosensors_usc_cpp_stream_histograms", (DL_FUNC) &_biosensors_usc_cpp_stream_histograms, 9},
+    {"_biosensors_usc_cpp_histogram_quantiles", (DL_FUNC) &_biosensors_usc_cpp_histogram_quantiles, 2},
+    {"_biosensors_usc_cpp_histogram_densities", (DL_FUNC) &_biosensors_usc_cpp_histogram_densities, 2},
+    {"_biosensors_usc_cpp_histogram_serialize", (DL_FUNC) &_biosensors_usc_cpp_histogram_serialize, 1},
+    {"_biosensors_usc_cpp_histogram_unserialize", (DL_FUNC) &_biosensors_usc_cpp_histogram_unserialize, 1},
     {NULL, NULL, 0}
 };
 
@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <iterator>
+#include <sstream>
 #include <RcppArmadillo.h>
 // [[Rcpp::depends(RcppArmadillo)]]
 
@@ -27,6 +28,21 @@
 #include "NadarayaRegression.h"
 #include "RidgeRegression.h"
 #include "ConfidenceBand.h"
+#include "CsvReader.h"
+#include "QuantileEstimation.h"
+#include "DensityEstimation.h"
+#include "QuantileSketch.h"
+#include "BiosensorStore.h"
+#include "StreamingReader.h"
+#include "HashJoin.h"
+#include "TimeWindows.h"
+#include "QuantileGrid.h"
+#include "QuantileCodec.h"
+#include "IngestionLog.h"
+#include "Resampling.h"
+#include "SyntheticData.h"
+#include "GlycemicMetrics.h"
+#include "ActivityHistogram.h"
 
 
 //' This function perform Frechet regression with the Wasserstein distance.
@@ -37,6 +53,7 @@
 //' @param xpred A kxp matrix of input values for regressors for prediction.
 //' @param t A 1xm vector - common grid for all quantile density functions in q.  If missing, defaults to linspace(0, 1, m);  For best results, should use a finer grid than for quantle estimation, especially near the boundaries.
 //' @param qdmin A positive lower bound on the estimated quantile densites. Defaults to 1e-6.
+//' @param solver The solver of the quadratic program that keeps the quantile densities above qdmin: 0 for the interior point method of alglib, 1 for ADMM on the banded structure of the program.
 //'
 //' @return An object containing the components:
 //' \code{xpred} See input of same name.
@@ -50,13 +67,14 @@
 //' \code{QP_used} A flag indicating whether OLS fits all satisfied the constraints (=0) or if the quadratic program was used in fitting (=1).
 // [[Rcpp::export]]
 Rcpp::List cpp_wasserstein_regression(const arma::mat xfit, const arma::mat q, const arma::mat Q0,
-                 const arma::mat xpred, const arma::vec t, const double qdmin) {
-  bio::regression_struct result = bio::wasserstein_regression(xfit, q, Q0, xpred, t, qdmin);
+                 const arma::mat xpred, const arma::vec t, const double qdmin, const int solver) {
+  bio::regression_struct result = bio::wasserstein_regression(xfit, q, Q0, xpred, t, qdmin, solver);
   return Rcpp::List::create(
     Rcpp::Named("q")       = q,
     Rcpp::Named("Q0")      = Q0,
     Rcpp::Named("t")       = t,
     Rcpp::Named("qdmin")   = qdmin,
+    Rcpp::Named("solver")  = solver,
     Rcpp::Named("xfit")    = result.xfit,
     Rcpp::Named("xpred")   = result.xpred,
     Rcpp::Named("Qfit")    = result.Qfit,
@@ -147,4 +165,488 @@ Rcpp::List cpp_ridge_regression(const arma::mat dist, const arma::vec Y, const a
 
 
 
+bio::csv_options clean_options(const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes,
+                             const double min, const double max) {
+  bio::csv_options options;
+  options.sentinels = Rcpp::as<std::vector<std::string> >(sentinels);
+  options.substitutes = Rcpp::as<std::vector<double> >(substitutes);
+  if (options.sentinels.size() != options.substitutes.size())
+    Rcpp::stop("Arguments 'sentinels' and 'substitutes' must have the same length");
+  options.min = min;
+  options.max = max;
+  return options;
+}
+
+Rcpp::List csv_list(const bio::csv_struct& result) {
+  Rcpp::IntegerVector id(result.id.n_elem);
+  for (arma::uword i=0; i < result.id.n_elem; i++)
+    id[i] = result.id(i) + 1;
+  id.attr("levels") = Rcpp::wrap(result.ids);
+  id.attr("class") = "factor";
+
+  return Rcpp::List::create(
+    Rcpp::Named("time")            = Rcpp::NumericVector(result.time.begin(), result.time.end()),
+    Rcpp::Named("value")           = Rcpp::NumericVector(result.value.begin(), result.value.end()),
+    Rcpp::Named("id")              = id,
+    Rcpp::Named("rows")            = (double) result.rows,
+    Rcpp::Named("rejected")        = (double) result.rejected,
+    Rcpp::Named("seconds")         = result.seconds,
+    Rcpp::Named("rows_per_second") = result.rows_per_second,
+    Rcpp::Named("counts")          = Rcpp::List::create(
+      Rcpp::Named("id")          = result.subjects,
+      Rcpp::Named("valid")       = Rcpp::NumericVector(result.counts.colptr(0), result.counts.colptr(0) + result.counts.n_rows),
+      Rcpp::Named("substituted") = Rcpp::NumericVector(result.counts.colptr(1), result.counts.colptr(1) + result.counts.n_rows),
+      Rcpp::Named("rejected")    = Rcpp::NumericVector(result.counts.colptr(2), result.counts.colptr(2) + result.counts.n_rows)
+    )
+  );
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_read_csv(const std::string filename, const int threads, const Rcpp::CharacterVector sentinels,
+                        const Rcpp::NumericVector substitutes, const double min, const double max) {
+  return csv_list(bio::read_csv(filename, threads, clean_options(sentinels, substitutes, min, max)));
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_read_csv_files(const std::vector<std::string> filenames, const int threads,
+                              const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes,
+                              const double min, const double max) {
+  return csv_list(bio::read_csv_files(filenames, threads, clean_options(sentinels, substitutes, min, max)));
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_quantile_matrix(const arma::uvec id, const arma::vec value, const int groups, const arma::vec t) {
+  return bio::quantile_matrix(id, value, groups, t);
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_density_matrix(const arma::uvec id, const arma::vec value, const int groups, const arma::vec t) {
+  return bio::density_matrix(id, value, groups, t);
+}
+
+
+
+// [[Rcpp::export]]
+SEXP cpp_sketch_create(const int k) {
+  Rcpp::XPtr<bio::sketch_set> sketch(new bio::sketch_set(k), true);
+  return sketch;
+}
+
+// [[Rcpp::export]]
+void cpp_sketch_update(SEXP sketch, const std::vector<std::string> ids, const arma::uvec id, const arma::vec value) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  set->update(ids, id, value);
+}
+
+// [[Rcpp::export]]
+void cpp_sketch_update_file(SEXP sketch, const std::string filename, const int threads) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  bio::csv_struct csv = bio::read_csv(filename, threads);
+  set->update(csv.ids, csv.id, csv.value);
+}
+
+// [[Rcpp::export]]
+void cpp_sketch_merge(SEXP sketch, SEXP other) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  Rcpp::XPtr<bio::sketch_set> from(other);
+  set->merge(*from);
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_sketch_quantiles(SEXP sketch, const arma::vec t) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  Rcpp::NumericVector count(set->size()), min(set->size()), max(set->size());
+  for (arma::uword i=0; i < set->size(); i++) {
+    count[i] = (double) set->sketch(i).count();
+    min[i] = set->sketch(i).min();
+    max[i] = set->sketch(i).max();
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("ids")       = set->ids(),
+    Rcpp::Named("count")     = count,
+    Rcpp::Named("min")       = min,
+    Rcpp::Named("max")       = max,
+    Rcpp::Named("quantiles") = set->quantiles(t)
+  );
+}
+
+
+
+// [[Rcpp::export]]
+void cpp_store_write(const std::string filename, const Rcpp::List sections) {
+  Rcpp::CharacterVector names = sections.names();
+  std::vector<bio::store_section> result(sections.size());
+  for (R_xlen_t i=0; i < sections.size(); i++) {
+    SEXP x = sections[i];
+    bio::store_section& s = result[i];
+    s.name = Rcpp::as<std::string>(names[i]);
+    s.flags = Rf_isMatrix(x) ? bio::STORE_MATRIX : 0;
+    s.rows = Rf_isMatrix(x) ? Rf_nrows(x) : Rf_xlength(x);
+    s.cols = Rf_isMatrix(x) ? Rf_ncols(x) : 1;
+    switch (TYPEOF(x)) {
+    case REALSXP:
+      s.type = bio::STORE_DOUBLE;
+      s.data = REAL(x);
+      break;
+    case INTSXP:
+      s.type = bio::STORE_INT32;
+      s.data = INTEGER(x);
+      break;
+    case LGLSXP:
+      s.type = bio::STORE_LOGICAL;
+      s.data = LOGICAL(x);
+      break;
+    case STRSXP:
+      s.type = bio::STORE_STRING;
+      s.data = NULL;
+      s.strings = Rcpp::as<std::vector<std::string> >(x);
+      break;
+    default:
+      Rcpp::stop("Unsupported type in section " + s.name);
+    }
+  }
+  bio::write_store(filename, result);
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_store_read(const std::string filename) {
+  bio::biosensor_store store(filename);
+  std::vector<std::string> names = store.names();
+  Rcpp::List result(names.size());
+  for (size_t i=0; i < names.size(); i++) {
+    const bio::store_entry& e = store.entry(names[i]);
+    SEXP x;
+    switch (e.type) {
+    case bio::STORE_DOUBLE:
+      x = PROTECT(Rf_allocVector(REALSXP, e.rows * e.cols));
+      memcpy(REAL(x), store.data(names[i]), e.bytes);
+      break;
+    case bio::STORE_INT32:
+      x = PROTECT(Rf_allocVector(INTSXP, e.rows * e.cols));
+      memcpy(INTEGER(x), store.data(names[i]), e.bytes);
+      break;
+    case bio::STORE_LOGICAL:
+      x = PROTECT(Rf_allocVector(LGLSXP, e.rows * e.cols));
+      memcpy(LOGICAL(x), store.data(names[i]), e.bytes);
+      break;
+    default:
+      x = PROTECT(Rcpp::wrap(store.strings(names[i])));
+      break;
+    }
+    if (e.flags & bio::STORE_MATRIX) {
+      Rcpp::IntegerVector dim = Rcpp::IntegerVector::create(e.rows, e.cols);
+      Rf_setAttrib(x, R_DimSymbol, dim);
+    }
+    result[i] = x;
+    UNPROTECT(1);
+  }
+  result.names() = names;
+  return result;
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_sketch_densities(SEXP sketch, const arma::vec t) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  return bio::sketch_density_matrix(*set, t);
+}
+
+// [[Rcpp::export]]
+Rcpp::RawVector cpp_sketch_serialize(SEXP sketch) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  std::ostringstream out;
+  set->write(out);
+  std::string bytes = out.str();
+  return Rcpp::RawVector(bytes.begin(), bytes.end());
+}
+
+// [[Rcpp::export]]
+SEXP cpp_sketch_unserialize(const Rcpp::RawVector bytes) {
+  std::istringstream in(std::string(bytes.begin(), bytes.end()));
+  Rcpp::XPtr<bio::sketch_set> sketch(new bio::sketch_set(), true);
+  sketch->read(in);
+  return sketch;
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_stream_csv(SEXP sketch, const std::string filename, const double chunk_bytes, const int threads,
+                          const Rcpp::CharacterVector sentinels, const Rcpp::NumericVector substitutes,
+                          const double min, const double max) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  bio::stream_struct result = bio::stream_csv(filename, (size_t) chunk_bytes, *set, threads,
+                                              clean_options(sentinels, substitutes, min, max));
+  return Rcpp::List::create(
+    Rcpp::Named("rows")            = (double) result.rows,
+    Rcpp::Named("rejected")        = (double) result.rejected,
+    Rcpp::Named("chunks")          = (double) result.chunks,
+    Rcpp::Named("seconds")         = result.seconds,
+    Rcpp::Named("rows_per_second") = result.rows_per_second
+  );
+}
+
+
+
+// [[Rcpp::export]]
+Rcpp::List cpp_join_ids(const std::vector<std::string> keys, const std::vector<std::string> ids) {
+  bio::join_struct result = bio::join_ids(keys, ids);
+  arma::uvec* index[3] = {&result.rows, &result.unmatched, &result.duplicated};
+  Rcpp::List list(3);
+  for (int k=0; k < 3; k++) {
+    Rcpp::IntegerVector x(index[k]->n_elem);
+    for (arma::uword i=0; i < index[k]->n_elem; i++)
+      x[i] = (*index[k])(i) + 1;
+    list[k] = x;
+  }
+  list.names() = Rcpp::CharacterVector::create("rows", "unmatched", "duplicated");
+  return list;
+}
+
+
+
+// [[Rcpp::export]]
+Rcpp::List cpp_window_quantiles(const arma::uvec id, const arma::vec time, const arma::vec value, const int groups,
+                                const arma::vec t, const double from, const double to, const double width,
+                                const double step, const int min_count) {
+  bio::window_struct result = width > 0
+    ? bio::sliding_window_quantiles(id, time, value, groups, t, width, step, min_count)
+    : bio::calendar_window_quantiles(id, time, value, groups, t, from, to, min_count);
+
+  Rcpp::IntegerVector subject(result.subject.n_elem), count(result.count.n_elem);
+  for (arma::uword i=0; i < result.subject.n_elem; i++) {
+    subject[i] = result.subject(i) + 1;
+    count[i] = result.count(i);
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("subject")   = subject,
+    Rcpp::Named("start")     = Rcpp::NumericVector(result.start.begin(), result.start.end()),
+    Rcpp::Named("count")     = count,
+    Rcpp::Named("quantiles") = result.quantiles
+  );
+}
+
+
 
+// [[Rcpp::export]]
+arma::vec cpp_quantile_grid(const arma::uvec id, const arma::vec value, const int groups, const double tol,
+                            const int min_points, const int max_points, const int resolution) {
+  return bio::quantile_grid(id, value, groups, tol, min_points, max_points, resolution);
+}
+
+
+// [[Rcpp::export]]
+arma::vec cpp_sketch_grid(SEXP sketch, const double tol, const int min_points, const int max_points,
+                          const int resolution) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  arma::vec p = arma::linspace(0, 1, resolution + 1);
+  return bio::refine_grid(set->quantiles(p), tol, min_points, max_points);
+}
+
+
+
+bio::quantile_codec codec_view(const Rcpp::List& x) {
+  Rcpp::NumericVector base = x["base"];
+  Rcpp::NumericVector scale = x["scale"];
+  Rcpp::RawVector deltas = x["deltas"];
+  bio::quantile_codec codec = {(arma::uword) base.size(), (arma::uword) Rcpp::as<int>(x["m"]),
+                               (arma::uword) Rcpp::as<int>(x["block"]), Rcpp::as<int>(x["precision"]),
+                               base.begin(), scale.begin(), deltas.begin()};
+  if (codec.m < 2 || codec.block == 0 || scale.size() != base.size() ||
+      (size_t) deltas.size() != codec.n * (codec.m - 1) * codec.precision)
+    throw std::invalid_argument("Malformed compressed quantile matrix");
+  return codec;
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_encode_quantiles(const arma::mat Q, const int precision, const int block) {
+  bio::codec_struct result = bio::encode_quantiles(Q, precision, block);
+  Rcpp::RawVector deltas(result.deltas.begin(), result.deltas.end());
+  return Rcpp::List::create(
+    Rcpp::Named("base")   = Rcpp::NumericVector(result.base.begin(), result.base.end()),
+    Rcpp::Named("scale")  = Rcpp::NumericVector(result.scale.begin(), result.scale.end()),
+    Rcpp::Named("deltas") = deltas,
+    Rcpp::Named("error")  = result.error
+  );
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_decode_quantiles(const Rcpp::List x, const arma::uvec rows) {
+  return bio::decode_quantiles(codec_view(x), rows);
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_codec_distances(const Rcpp::List x, const Rcpp::List y, const arma::vec t) {
+  return bio::codec_distances(codec_view(x), codec_view(y), bio::trapezoid_weights(t));
+}
+
+
+// [[Rcpp::export]]
+Rcpp::List cpp_ingest_files(SEXP sketch, const std::vector<std::string> filenames, const std::string logname,
+                            const double chunk_bytes, const int threads, const Rcpp::CharacterVector sentinels,
+                            const Rcpp::NumericVector substitutes, const double min, const double max,
+                            const arma::vec t, const double tol, const int min_points, const int max_points,
+                            const int resolution) {
+  Rcpp::XPtr<bio::sketch_set> set(sketch);
+  bio::ingest_struct result = bio::ingest_files(filenames, logname, (size_t) chunk_bytes, *set, threads,
+                                                clean_options(sentinels, substitutes, min, max), t, tol,
+                                                min_points, max_points, resolution);
+  Rcpp::NumericVector lower(set->size()), upper(set->size());
+  for (arma::uword i=0; i < set->size(); i++) {
+    lower[i] = set->sketch(i).min();
+    upper[i] = set->sketch(i).max();
+  }
+  Rcpp::IntegerVector updated(result.updated.n_elem);
+  for (arma::uword i=0; i < result.updated.n_elem; i++)
+    updated[i] = result.updated(i) + 1;
+  return Rcpp::List::create(
+    Rcpp::Named("rows")            = (double) result.stream.rows,
+    Rcpp::Named("rejected")        = (double) result.stream.rejected,
+    Rcpp::Named("chunks")          = (double) result.stream.chunks,
+    Rcpp::Named("seconds")         = result.stream.seconds,
+    Rcpp::Named("rows_per_second") = result.stream.rows_per_second,
+    Rcpp::Named("bytes")           = (double) result.stream.bytes,
+    Rcpp::Named("rebuilt")         = result.rebuilt,
+    Rcpp::Named("updated")         = updated,
+    Rcpp::Named("ids")             = set->ids(),
+    Rcpp::Named("min")             = lower,
+    Rcpp::Named("max")             = upper,
+    Rcpp::Named("grid")            = Rcpp::NumericVector(result.grid.begin(), result.grid.end()),
+    Rcpp::Named("quantiles")       = result.quantiles
+  );
+}
+
+
+// [[Rcpp::export]]
+Rcpp::List cpp_resample(const arma::uvec id, const arma::vec time, const arma::vec value, const int groups,
+                        const double step, const double max_gap, const int method) {
+  bio::resample_struct result = bio::resample_series(id, time, value, groups, step, max_gap, method);
+  Rcpp::IntegerVector subject(result.subject.n_elem);
+  for (arma::uword i=0; i < result.subject.n_elem; i++)
+    subject[i] = result.subject(i) + 1;
+  Rcpp::IntegerMatrix counts(result.counts.n_rows, result.counts.n_cols);
+  for (arma::uword i=0; i < result.counts.n_elem; i++)
+    counts[i] = result.counts(i);
+  return Rcpp::List::create(
+    Rcpp::Named("subject") = subject,
+    Rcpp::Named("time")    = Rcpp::NumericVector(result.time.begin(), result.time.end()),
+    Rcpp::Named("value")   = Rcpp::NumericVector(result.value.begin(), result.value.end()),
+    Rcpp::Named("counts")  = counts
+  );
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_grid_derivative(arma::mat Q, const arma::vec t) {
+  bio::grid_derivative(Q, t);
+  return Q;
+}
+
+
+// [[Rcpp::export]]
+arma::mat cpp_quantile_to_density(const arma::mat Q, const arma::mat q, const arma::vec x) {
+  return bio::quantile_to_density(Q, q, x);
+}
+
+
+// [[Rcpp::export]]
+Rcpp::List cpp_generate_data(const int n, const arma::vec Q0, const int Xp, const int scenario, const double seed,
+                             const arma::vec t, const std::string filename) {
+  bio::synthetic_struct cohort = bio::generate_cohort(n, Q0, Xp, scenario, (uint64_t) seed);
+  if (!filename.empty()) {
+    bio::write_cohort(filename, cohort, t);
+    return Rcpp::List::create();
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("X")         = cohort.X,
+    Rcpp::Named("quantiles") = cohort.quantiles
+  );
+}
+
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix cpp_glycemic_metrics(const arma::uvec id, const arma::vec time, const arma::vec value,
+                                         const int groups) {
+  arma::mat metrics = bio::glycemic_metrics(id, time, value, groups);
+  Rcpp::NumericMatrix result(metrics.n_rows, metrics.n_cols, metrics.begin());
+  Rcpp::CharacterVector names(bio::GLYCEMIC_METRICS, bio::GLYCEMIC_METRICS + bio::GLYCEMIC_COUNT);
+  Rcpp::colnames(result) = names;
+  return result;
+}
+
+
+// [[Rcpp::export]]
+SEXP cpp_histogram_create(const double lo, const double hi, const double width) {
+  Rcpp::XPtr<bio::histogram_set> histogram(new bio::histogram_set(lo, hi, width), true);
+  return histogram;
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_stream_histograms(SEXP histogram, const std::vector<std::string> filenames,
+                                 const std::vector<std::string> subjects, const double chunk_bytes,
+                                 const int threads, const Rcpp::CharacterVector sentinels,
+                                 const Rcpp::NumericVector substitutes, const double min, const double max) {
+  if (subjects.size() != filenames.size())
+    throw std::invalid_argument("There must be a subject for each file");
+  Rcpp::XPtr<bio::histogram_set> set(histogram);
+  bio::csv_options options = clean_options(sentinels, substitutes, min, max);
+  double rows = 0, rejected = 0, chunks = 0, seconds = 0;
+  for (size_t f=0; f < filenames.size(); f++) {
+    bio::stream_struct result = bio::stream_csv(filenames[f], (size_t) chunk_bytes, *set, threads, options, 0,
+                                                subjects[f]);
+    rows += result.rows;
+    rejected += result.rejected;
+    chunks += result.chunks;
+    seconds += result.seconds;
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("rows")            = rows,
+    Rcpp::Named("rejected")        = rejected,
+    Rcpp::Named("chunks")          = chunks,
+    Rcpp::Named("seconds")         = seconds,
+    Rcpp::Named("rows_per_second") = seconds > 0 ? rows / seconds : 0
+  );
+}
+
+// [[Rcpp::export]]
+Rcpp::List cpp_histogram_quantiles(SEXP histogram, const arma::vec t) {
+  Rcpp::XPtr<bio::histogram_set> set(histogram);
+  Rcpp::NumericVector count(set->size()), min(set->size()), max(set->size());
+  for (arma::uword i=0; i < set->size(); i++) {
+    count[i] = (double) set->histogram(i).count();
+    min[i] = set->histogram(i).min();
+    max[i] = set->histogram(i).max();
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("ids")       = set->ids(),
+    Rcpp::Named("count")     = count,
+    Rcpp::Named("min")       = min,
+    Rcpp::Named("max")       = max,
+    Rcpp::Named("quantiles") = set->quantiles(t)
+  );
+}
+
+// [[Rcpp::export]]
+arma::mat cpp_histogram_densities(SEXP histogram, const arma::vec t) {
+  Rcpp::XPtr<bio::histogram_set> set(histogram);
+  return set->densities(t);
+}
+
+// [[Rcpp::export]]
+Rcpp::RawVector cpp_histogram_serialize(SEXP histogram) {
+  Rcpp::XPtr<bio::histogram_set> set(histogram);
+  std::ostringstream out;
+  set->write(out);
+  std::string bytes = out.str();
+  return Rcpp::RawVector(bytes.begin(), bytes.end());
+}
+
+// [[Rcpp::export]]
+SEXP cpp_histogram_unserialize(const Rcpp::RawVector bytes) {
+  std::istringstream in(std::string(bytes.begin(), bytes.end()));
+  Rcpp::XPtr<bio::histogram_set> histogram(new bio::histogram_set(0, 1, 1), true);
+  histogram->read(in);
+  return histogram;
+}